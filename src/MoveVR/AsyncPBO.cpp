@@ -20,17 +20,139 @@
 #include "src/Logger.h"
 #include "AsyncPBO.h"
 
+namespace {
+    // states of the shared upload, the draw callback only takes frames that are done
+    constexpr const int UPLOAD_IDLE = 0;
+    constexpr const int UPLOAD_BUSY = 1;
+    constexpr const int UPLOAD_DONE = 2;
+
+    void gridSize(int width, int height, int maxTile, int &cols, int &rows) {
+        if (maxTile <= 0) {
+            maxTile = width;
+        }
+        cols = (width + maxTile - 1) / maxTile;
+        rows = (height + maxTile - 1) / maxTile;
+    }
+
+    void layoutTiles(std::vector<AsyncPBO::Tile> &tiles, int width, int height, int cols, int rows) {
+        int tileWidth = (width + cols - 1) / cols;
+        int tileHeight = (height + rows - 1) / rows;
+
+        for (int row = 0; row < rows; row++) {
+            for (int col = 0; col < cols; col++) {
+                AsyncPBO::Tile &tile = tiles[row * cols + col];
+                tile.x = col * tileWidth;
+                tile.y = row * tileHeight;
+                tile.width = (tile.x + tileWidth <= width) ? tileWidth : width - tile.x;
+                tile.height = (tile.y + tileHeight <= height) ? tileHeight : height - tile.y;
+
+                tile.texX = tile.x > 0 ? tile.x - 1 : 0;
+                tile.texY = tile.y > 0 ? tile.y - 1 : 0;
+                int texRight = (tile.x + tile.width < width) ? tile.x + tile.width + 1 : width;
+                int texBottom = (tile.y + tile.height < height) ? tile.y + tile.height + 1 : height;
+                tile.texWidth = texRight - tile.texX;
+                tile.texHeight = texBottom - tile.texY;
+
+                tile.u0 = (tile.x - tile.texX) / (float) tile.texWidth;
+                tile.v0 = (tile.y - tile.texY) / (float) tile.texHeight;
+                tile.u1 = (tile.x + tile.width - tile.texX) / (float) tile.texWidth;
+                tile.v1 = (tile.y + tile.height - tile.texY) / (float) tile.texHeight;
+            }
+        }
+    }
+
+    void setTextureParameters() {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    void deleteTileTextures(std::vector<AsyncPBO::Tile> &tiles) {
+        for (auto &tile: tiles) {
+            glDeleteTextures(1, &tile.texture);
+        }
+        tiles.clear();
+    }
+}
+
+// the back textures and staging buffer belong to the upload thread until the upload is done
+struct AsyncPBO::SharedUpload {
+    int maxTile = 0;
+    unsigned int buffer = 0;
+    std::vector<Tile> tiles;
+    int width = 0, height = 0;
+    // signaled when the GPU finished the upload
+    GLsync fence = nullptr;
+    // signaled when the GPU stopped drawing the textures that were handed back for the next upload
+    GLsync released = nullptr;
+    std::atomic_int state { UPLOAD_IDLE };
+};
+
 AsyncPBO::AsyncPBO() {
 }
 
 AsyncPBO::~AsyncPBO() {
-    glDeleteBuffers(2, pbos);
+    if (shared) {
+        // the objects are shared with the upload context, it frees them after its pending uploads
+        auto upload = shared;
+        auto front = std::make_shared<std::vector<Tile>>(std::move(tiles));
+        uploader->post([upload, front] {
+            deleteTileTextures(*front);
+            deleteTileTextures(upload->tiles);
+            if (upload->buffer) {
+                glDeleteBuffers(1, &upload->buffer);
+            }
+            if (upload->fence) {
+                glDeleteSync(upload->fence);
+            }
+            if (upload->released) {
+                glDeleteSync(upload->released);
+            }
+        });
+        return;
+    }
+
+    deleteTiles();
+    if (pool) {
+        if (currentPtr) {
+            unmapBuffer(backIndex);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        pool->releaseBuffer(pbos[0]);
+        pool->releaseBuffer(pbos[1]);
+    } else {
+        glDeleteBuffers(2, pbos);
+    }
 }
 
-void AsyncPBO::init(int width, int height, int stride) {
+void AsyncPBO::init(int width, int height, int stride, BindFunction bindTexture,
+        std::shared_ptr<GLObjectPool> objectPool, std::shared_ptr<UploadContext> uploadContext)
+{
+    bind = bindTexture;
+    pool = objectPool;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
     backIndex = 0;
     frontIndex = 1;
-    glGenBuffers(2, pbos);
+
+    if (uploadContext) {
+        // the buffers live on the upload thread, the back buffer only carries the requested size
+        // the tasks must not own the context, otherwise it could be destroyed on its own thread
+        uploader = uploadContext;
+        shared = std::make_shared<SharedUpload>();
+        shared->maxTile = getMaxTileSize();
+        setSize(width, height, stride);
+        newBackBuffer = false;
+        return;
+    }
+
+    if (pool) {
+        pbos[0] = pool->acquireBuffer();
+        pbos[1] = pool->acquireBuffer();
+    } else {
+        glGenBuffers(2, pbos);
+    }
 
     newWidth = width;
     newHeight = height;
@@ -72,24 +194,66 @@ void AsyncPBO::unmapBuffer(size_t idx) {
 void AsyncPBO::resizeTextureToBuffer(size_t bufIdx) {
     int needWidth = bufWidth[bufIdx];
     int needHeight = bufheight[bufIdx];
-    int needStride = bufStride[bufIdx];
 
     if (texWidth == needWidth && texHeight == needHeight) {
         return;
     }
 
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[bufIdx]);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, needStride / sizeof(uint32_t));
-    glTexImage2D(GL_TEXTURE_2D, 0,
-        GL_RGBA, needWidth, needHeight, 0,
-        GL_BGR, GL_UNSIGNED_BYTE, nullptr);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    createTiles(needWidth, needHeight);
+
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    for (auto &tile: tiles) {
+        bind(tile.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0,
+            GL_RGBA, tile.texWidth, tile.texHeight, 0,
+            GL_BGR, GL_UNSIGNED_BYTE, nullptr);
+    }
 
     texWidth = bufWidth[bufIdx];
     texHeight = bufheight[bufIdx];
 }
 
+void AsyncPBO::createTiles(int width, int height) {
+    int cols, rows;
+    gridSize(width, height, getMaxTileSize(), cols, rows);
+
+    if ((int) tiles.size() != cols * rows) {
+        deleteTiles();
+        tiles.resize(cols * rows);
+        for (auto &tile: tiles) {
+            tile.texture = createTexture();
+            bind(tile.texture);
+            setTextureParameters();
+        }
+        if (tiles.size() > 1) {
+            logger::verbose("Using %dx%d tiles for %dx%d frame", cols, rows, width, height);
+        }
+    }
+
+    layoutTiles(tiles, width, height, cols, rows);
+}
+
+void AsyncPBO::deleteTiles() {
+    for (auto &tile: tiles) {
+        if (pool) {
+            pool->releaseTexture(tile.texture);
+        } else {
+            glDeleteTextures(1, &tile.texture);
+        }
+    }
+    tiles.clear();
+}
+
+unsigned int AsyncPBO::createTexture() {
+    if (pool) {
+        return pool->acquireTexture();
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    return texture;
+}
+
 int AsyncPBO::getBackbufferWidth() {
     return bufWidth[backIndex];
 }
@@ -127,6 +291,128 @@ void AsyncPBO::setSize(int width, int height, int stride) {
     newWidth = width;
     newHeight = height;
     newStride = stride;
+
+    if (shared) {
+        // there is no real back buffer, uploads use whatever size the frame has
+        bufWidth[backIndex] = width;
+        bufheight[backIndex] = height;
+        bufStride[backIndex] = stride;
+    }
+}
+
+bool AsyncPBO::hasUploadContext() {
+    return shared != nullptr;
+}
+
+bool AsyncPBO::canUpload() {
+    return shared && !buffersReleased && shared->state == UPLOAD_IDLE;
+}
+
+void AsyncPBO::upload(int width, int height, int stride, FillFunction fill) {
+    auto upload = shared;
+    upload->state = UPLOAD_BUSY;
+    uploader->post([upload, width, height, stride, fill] {
+        uploadFrame(*upload, width, height, stride, fill);
+    });
+}
+
+void AsyncPBO::uploadFrame(SharedUpload &upload, int width, int height, int stride, const FillFunction &fill) {
+    // runs on the upload thread
+    if (upload.released) {
+        // the textures might still be read by the simulator's previous frames
+        glWaitSync(upload.released, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(upload.released);
+        upload.released = nullptr;
+    }
+
+    int cols, rows;
+    gridSize(width, height, upload.maxTile, cols, rows);
+
+    if ((int) upload.tiles.size() != cols * rows) {
+        deleteTileTextures(upload.tiles);
+        upload.tiles.resize(cols * rows);
+        for (auto &tile: upload.tiles) {
+            glGenTextures(1, &tile.texture);
+            glBindTexture(GL_TEXTURE_2D, tile.texture);
+            setTextureParameters();
+        }
+        upload.width = 0;
+    }
+
+    if (upload.width != width || upload.height != height) {
+        layoutTiles(upload.tiles, width, height, cols, rows);
+        for (auto &tile: upload.tiles) {
+            glBindTexture(GL_TEXTURE_2D, tile.texture);
+            glTexImage2D(GL_TEXTURE_2D, 0,
+                GL_RGBA, tile.texWidth, tile.texHeight, 0,
+                GL_BGR, GL_UNSIGNED_BYTE, nullptr);
+        }
+        upload.width = width;
+        upload.height = height;
+    }
+
+    if (!upload.buffer) {
+        glGenBuffers(1, &upload.buffer);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, height * stride, nullptr, GL_STREAM_DRAW);
+    void *ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if (!ptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        logger::warn("Couldn't map upload buffer");
+        upload.state = UPLOAD_IDLE;
+        return;
+    }
+    fill(ptr);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    for (auto &tile: upload.tiles) {
+        size_t offset = tile.texY * stride + tile.texX * 3;
+        glBindTexture(GL_TEXTURE_2D, tile.texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0,
+                        0, 0,
+                        tile.texWidth, tile.texHeight,
+                        GL_BGR, GL_UNSIGNED_BYTE, (const void *) offset);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the fence must be flushed or the draw callback could wait for it forever
+    upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    upload.state = UPLOAD_DONE;
+}
+
+void AsyncPBO::takeUploadedFrame() {
+    if (shared->state != UPLOAD_DONE) {
+        return;
+    }
+
+    // never block the draw callback, an unfinished upload is taken in one of the next frames
+    GLenum res = glClientWaitSync(shared->fence, 0, 0);
+    if (res != GL_ALREADY_SIGNALED && res != GL_CONDITION_SATISFIED) {
+        return;
+    }
+    glDeleteSync(shared->fence);
+    shared->fence = nullptr;
+
+    std::swap(tiles, shared->tiles);
+    std::swap(texWidth, shared->width);
+    std::swap(texHeight, shared->height);
+
+    // changes from another context are only guaranteed to be visible after binding again
+    for (auto &tile: tiles) {
+        bind(tile.texture);
+    }
+
+    // the old front textures are overwritten by the next upload once the draws using them are done
+    shared->released = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    shared->state = UPLOAD_IDLE;
 }
 
 int AsyncPBO::getFrontbufferWidth() {
@@ -137,7 +423,101 @@ int AsyncPBO::getFrontbufferHeight() {
     return texHeight;
 }
 
+int AsyncPBO::getMaxTileSize() {
+    // leave room for the border on both sides
+    return maxTextureSize > 2 ? maxTextureSize - 2 : 0;
+}
+
+const std::vector<AsyncPBO::Tile> &AsyncPBO::getTiles() {
+    return tiles;
+}
+
+size_t AsyncPBO::getGpuBytes() {
+    size_t bytes = 0;
+    if (shared) {
+        // the back textures belong to the upload thread, assume they have the size of the front textures
+        for (auto &tile: tiles) {
+            bytes += (size_t) tile.texWidth * tile.texHeight * 4 * 2;
+        }
+        if (!buffersReleased) {
+            bytes += (size_t) newHeight * newStride;
+        }
+        return bytes;
+    }
+
+    for (size_t i = 0; i < 2; i++) {
+        bytes += (size_t) bufheight[i] * bufStride[i];
+    }
+    for (auto &tile: tiles) {
+        // GL_RGBA textures
+        bytes += (size_t) tile.texWidth * tile.texHeight * 4;
+    }
+    return bytes;
+}
+
+void AsyncPBO::releaseBuffers() {
+    if (buffersReleased) {
+        return;
+    }
+
+    if (shared) {
+        auto upload = shared;
+        uploader->post([upload] {
+            if (upload->buffer) {
+                glDeleteBuffers(1, &upload->buffer);
+                upload->buffer = 0;
+            }
+        });
+        buffersReleased = true;
+        return;
+    }
+
+    if (currentPtr) {
+        unmapBuffer(backIndex);
+        currentPtr = nullptr;
+    }
+
+    for (size_t i = 0; i < 2; i++) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+        bufWidth[i] = 0;
+        bufheight[i] = 0;
+        bufStride[i] = 0;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    newBackBuffer = false;
+    frontValid = false;
+    buffersReleased = true;
+}
+
+void AsyncPBO::restoreBuffers() {
+    if (!buffersReleased) {
+        return;
+    }
+
+    if (shared) {
+        // the upload thread creates its buffer with the next frame
+        buffersReleased = false;
+        return;
+    }
+
+    resizeBufferIfNeeded(backIndex, newWidth, newHeight, newStride);
+    resizeBufferIfNeeded(frontIndex, newWidth, newHeight, newStride);
+    currentPtr = mapBuffer(backIndex);
+    buffersReleased = false;
+}
+
 void AsyncPBO::drawFrontBuffer() {
+    if (buffersReleased) {
+        return;
+    }
+
+    if (shared) {
+        takeUploadedFrame();
+        return;
+    }
+
     resizeTextureToBuffer(frontIndex);
 
     if (!newBackBuffer) {
@@ -145,7 +525,10 @@ void AsyncPBO::drawFrontBuffer() {
         return;
     }
 
-    drawTextureFromBuffer(frontIndex);
+    // the front buffer doesn't contain a frame yet after (re-)allocating the buffers
+    if (frontValid) {
+        drawTextureFromBuffer(frontIndex);
+    }
 
     // swap buffers
     unmapBuffer(backIndex);
@@ -156,13 +539,22 @@ void AsyncPBO::drawFrontBuffer() {
     currentPtr = mapBuffer(backIndex);
 
     newBackBuffer = false;
+    frontValid = true;
 }
 
 void AsyncPBO::drawTextureFromBuffer(size_t idx)  {
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[idx]);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, bufWidth[idx]);
+
+    // each tile is uploaded on its own from its part of the buffer
+    for (auto &tile: tiles) {
+        size_t offset = tile.texY * bufStride[idx] + tile.texX * 3;
+        bind(tile.texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0,
+                        0, 0,
+                        tile.texWidth, tile.texHeight,
+                        GL_BGR, GL_UNSIGNED_BYTE, (const void *) offset);
+    }
 
-    glTexSubImage2D(GL_TEXTURE_2D, 0,
-                    0, 0,
-                    texWidth, texHeight,
-                    GL_BGR, GL_UNSIGNED_BYTE, nullptr);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 }
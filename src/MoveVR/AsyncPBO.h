@@ -20,13 +20,33 @@
 
 #include <atomic>
 #include <functional>
+#include <vector>
+#include <memory>
+#include "GLObjectPool.h"
+#include "UploadContext.h"
 
 class AsyncPBO final {
 public:
+    using BindFunction = std::function<void(unsigned int)>;
+    using FillFunction = std::function<void(void *)>;
+
+    // sources larger than GL_MAX_TEXTURE_SIZE are split into a grid of textures
+    struct Tile {
+        unsigned int texture = 0;
+        // the part of the frame covered by this tile, in pixels
+        int x = 0, y = 0, width = 0, height = 0;
+        // the texture contains a border of neighboring pixels for seamless filtering
+        int texX = 0, texY = 0, texWidth = 0, texHeight = 0;
+        float u0 = 0, v0 = 0, u1 = 1, v1 = 1;
+    };
+
     AsyncPBO();
     ~AsyncPBO();
 
-    void init(int width, int height, int stride);
+    // GL objects are taken from and returned to the pool if one is given,
+    // frames are uploaded on the thread of the upload context if one is given
+    void init(int width, int height, int stride, BindFunction bindTexture,
+            std::shared_ptr<GLObjectPool> objectPool = nullptr, std::shared_ptr<UploadContext> uploadContext = nullptr);
 
     void *getBackBuffer();
     int getBackbufferWidth();
@@ -34,29 +54,60 @@ public:
     int getBackBufferStride();
     void finishBackBuffer();
 
+    // with an upload context, frames are passed to upload() instead of the back buffer
+    bool hasUploadContext();
+    // false while the previous frame is being uploaded or wasn't drawn yet
+    bool canUpload();
+    // the fill function is called on the upload thread to copy the frame into mapped memory
+    void upload(int width, int height, int stride, FillFunction fill);
+
     void setSize(int width, int height, int stride);
 
     int getFrontbufferWidth();
     int getFrontbufferHeight();
+    int getMaxTileSize();
+    const std::vector<Tile> &getTiles();
     void drawFrontBuffer();
 
+    // video memory of the buffers and textures
+    size_t getGpuBytes();
+
+    // frees the buffers while the texture keeps the last frame, e.g. for suspended windows
+    void releaseBuffers();
+    void restoreBuffers();
+
 private:
-    unsigned int pbos[2];
+    struct SharedUpload;
+
+    unsigned int pbos[2] {};
     std::atomic_size_t frontIndex, backIndex;
     std::atomic_int bufWidth[2], bufheight[2], bufStride[2];
     int texWidth = 0, texHeight = 0;
+    int maxTextureSize = 0;
+    std::vector<Tile> tiles;
+    BindFunction bind;
+    std::shared_ptr<GLObjectPool> pool;
     int newWidth = 0, newHeight = 0, newStride = 0;
 
     std::atomic_bool newBackBuffer;
+    bool frontValid = false;
+    bool buffersReleased = false;
 
     void *currentPtr = nullptr;
+    std::shared_ptr<UploadContext> uploader;
+    std::shared_ptr<SharedUpload> shared;
 
     void resizeBufferIfNeeded(size_t idx, int width, int height, int stride);
     void resizeTextureToBuffer(size_t bufIdx);
+    void createTiles(int width, int height);
+    void deleteTiles();
+    unsigned int createTexture();
     void *mapBuffer(size_t idx);
     void unmapBuffer(size_t idx);
 
     void drawTextureFromBuffer(size_t idx);
+    void takeUploadedFrame();
+    static void uploadFrame(SharedUpload &upload, int width, int height, int stride, const FillFunction &fill);
 };
 
 #endif //AVITAB_ASYNCPBO_H
@@ -0,0 +1,83 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <GL/glew.h>
+#include <XPLM/XPLMGraphics.h>
+#include "CursorOverlay.h"
+
+CursorOverlay::CursorOverlay() {
+}
+
+void CursorOverlay::draw(const Cursor &cursor, int x, int y, float scale) {
+    auto &shape = cursor.getShape();
+    if (shape.pixels.empty()) {
+        return;
+    }
+
+    if (textureId < 0) {
+        XPLMGenerateTextureNumbers(&textureId, 1);
+        XPLMBindTexture2d(textureId, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // 1 texture unit with alpha blending
+    XPLMSetGraphicsState(0, 1, 0, 1, 1, 0, 0);
+    XPLMBindTexture2d(textureId, 0);
+
+    if (uploadedVersion != cursor.getShapeVersion()) {
+        upload(shape);
+        uploadedVersion = cursor.getShapeVersion();
+    }
+
+    int left = x - shape.hotX * scale;
+    int top = y + shape.hotY * scale;
+    int right = left + shape.width * scale;
+    int bottom = top - shape.height * scale;
+
+    glColor4f(1, 1, 1, 1);
+    glBegin(GL_QUADS);
+        glTexCoord2i(0, 1);
+        glVertex2i(left, bottom);
+
+        glTexCoord2i(0, 0);
+        glVertex2i(left, top);
+
+        glTexCoord2i(1, 0);
+        glVertex2i(right, top);
+
+        glTexCoord2i(1, 1);
+        glVertex2i(right, bottom);
+    glEnd();
+}
+
+void CursorOverlay::upload(const Cursor::Shape &shape) {
+    // the capture PBO might still be bound
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, shape.width, shape.height, 0,
+            GL_BGRA, GL_UNSIGNED_BYTE, shape.pixels.data());
+}
+
+CursorOverlay::~CursorOverlay() {
+    if (textureId >= 0) {
+        GLuint tex = textureId;
+        glDeleteTextures(1, &tex);
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_CURSOROVERLAY_H_
+#define SRC_MOVEVR_CURSOROVERLAY_H_
+
+#include "src/windows/Cursor.h"
+
+// Draws the mouse cursor on top of a moved window so that cursor movements don't need a new capture
+class CursorOverlay {
+public:
+    CursorOverlay();
+
+    // x and y are the boxel position of the hotspot, scale is boxels per cursor pixel
+    void draw(const Cursor &cursor, int x, int y, float scale);
+
+    ~CursorOverlay();
+private:
+    int textureId = -1;
+    int uploadedVersion = -1;
+
+    void upload(const Cursor::Shape &shape);
+};
+
+#endif /* SRC_MOVEVR_CURSOROVERLAY_H_ */
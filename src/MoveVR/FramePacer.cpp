@@ -0,0 +1,108 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cmath>
+#include "FramePacer.h"
+
+namespace {
+    // longer gaps are pauses of the source, not jitter
+    constexpr const std::chrono::milliseconds MAX_INTERVAL(250);
+    constexpr const std::chrono::milliseconds MAX_DELAY(100);
+    constexpr const int MIN_SAMPLES = 8;
+
+    std::chrono::microseconds toMicros(float millis) {
+        return std::chrono::microseconds((int64_t) (millis * 1000));
+    }
+}
+
+void FramePacer::IntervalStats::add(Clock::time_point time) {
+    if (samples > 0) {
+        auto interval = time - last;
+        if (interval > MAX_INTERVAL) {
+            samples = 0;
+        } else {
+            float millis = std::chrono::duration<float, std::milli>(interval).count();
+            if (samples == 1) {
+                mean = millis;
+                deviation = 0;
+            } else {
+                deviation = deviation * 0.9f + std::abs(millis - mean) * 0.1f;
+                mean = mean * 0.9f + millis * 0.1f;
+            }
+        }
+    }
+    last = time;
+    samples++;
+}
+
+bool FramePacer::IntervalStats::isValid() const {
+    return samples >= MIN_SAMPLES;
+}
+
+void FramePacer::onCaptured(Clock::time_point captured) {
+    captures.add(captured);
+}
+
+FramePacer::Clock::time_point FramePacer::schedule(Clock::time_point captured) {
+    auto now = Clock::now();
+    if (!enabled || !captures.isValid()) {
+        return now;
+    }
+
+    // hold frames back long enough that late ones still arrive in time
+    auto delay = toMicros(captures.deviation * 2);
+    if (delay > MAX_DELAY) {
+        delay = MAX_DELAY;
+    }
+    auto due = captured + delay;
+
+    // keep the cadence of the source, but never fall further behind than the buffer allows
+    auto steady = lastPresent + toMicros(captures.mean);
+    if (steady > due) {
+        due = steady;
+    }
+    if (due > captured + MAX_DELAY) {
+        due = captured + MAX_DELAY;
+    }
+
+    return due > now ? due : now;
+}
+
+void FramePacer::onPresented(Clock::time_point presented) {
+    presents.add(presented);
+    lastPresent = presented;
+}
+
+void FramePacer::setEnabled(bool enable) {
+    enabled = enable;
+}
+
+bool FramePacer::isEnabled() {
+    return enabled;
+}
+
+float FramePacer::getSourceInterval() {
+    return captures.mean;
+}
+
+float FramePacer::getCaptureJitter() {
+    return captures.deviation;
+}
+
+float FramePacer::getPresentJitter() {
+    return presents.deviation;
+}
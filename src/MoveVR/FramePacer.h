@@ -0,0 +1,64 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_FRAMEPACER_H_
+#define SRC_MOVEVR_FRAMEPACER_H_
+
+#include <chrono>
+#include <atomic>
+
+/*
+ * A small jitter buffer for windows that play video: frames are held back
+ * by about twice the measured jitter of the captures and then released at
+ * the source's measured rate instead of whenever they arrive.
+ * Captures are measured by the capture thread before handing the frame on, so that
+ * waiting for the publish thread doesn't count as part of the source's interval.
+ * Scheduling is done by the publish thread, the statistics can be read from any thread.
+ */
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void onCaptured(Clock::time_point captured);
+    // returns when the frame should be presented, i.e. now if pacing is disabled
+    Clock::time_point schedule(Clock::time_point captured);
+    void onPresented(Clock::time_point presented);
+
+    void setEnabled(bool enable);
+    bool isEnabled();
+
+    // moving averages in milliseconds
+    float getSourceInterval();
+    float getCaptureJitter();
+    float getPresentJitter();
+private:
+    class IntervalStats {
+    public:
+        void add(Clock::time_point time);
+        bool isValid() const;
+        std::atomic<float> mean { 0 }, deviation { 0 };
+    private:
+        Clock::time_point last {};
+        std::atomic_int samples { 0 };
+    };
+
+    std::atomic_bool enabled { false };
+    IntervalStats captures, presents;
+    Clock::time_point lastPresent {};
+};
+
+#endif /* SRC_MOVEVR_FRAMEPACER_H_ */
@@ -0,0 +1,76 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "FrameQueue.h"
+
+FrameQueue::FrameQueue(size_t capacity):
+    capacity(capacity > 0 ? capacity : 1)
+{
+}
+
+void FrameQueue::setCapacity(size_t newCapacity) {
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = newCapacity > 0 ? newCapacity : 1;
+    notFull.notify_all();
+}
+
+bool FrameQueue::push(Frame &&frame) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this] { return closed || frames.size() < capacity; });
+    if (closed) {
+        return false;
+    }
+
+    bytes += frame.shot.pixels.capacity();
+    frames.push_back(std::move(frame));
+    notEmpty.notify_one();
+    return true;
+}
+
+bool FrameQueue::pop(Frame &frame) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this] { return closed || !frames.empty(); });
+    if (closed) {
+        return false;
+    }
+
+    frame = std::move(frames.front());
+    frames.pop_front();
+    bytes -= frame.shot.pixels.capacity();
+    notFull.notify_one();
+    return true;
+}
+
+void FrameQueue::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    frames.clear();
+    bytes = 0;
+    notFull.notify_all();
+    notEmpty.notify_all();
+}
+
+void FrameQueue::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    frames.clear();
+    bytes = 0;
+    notFull.notify_all();
+}
+
+size_t FrameQueue::getBytes() const {
+    return bytes;
+}
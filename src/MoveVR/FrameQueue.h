@@ -0,0 +1,62 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_FRAMEQUEUE_H_
+#define SRC_MOVEVR_FRAMEQUEUE_H_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include "src/windows/Window.h"
+
+/*
+ * Bounded hand-off between the stages of a window's capture pipeline.
+ * A full queue blocks the producing stage, so the pipeline runs at the
+ * rate of its slowest stage without piling up frames.
+ */
+class FrameQueue {
+public:
+    struct Frame {
+        Window::Screenshot shot;
+        // steady clock time when the capture finished
+        std::chrono::steady_clock::time_point captured;
+    };
+
+    explicit FrameQueue(size_t capacity);
+    void setCapacity(size_t capacity);
+
+    // false if the queue was closed while waiting
+    bool push(Frame &&frame);
+    bool pop(Frame &frame);
+
+    // wakes up all waiting stages, pushing and popping fail afterwards
+    void close();
+    void clear();
+
+    size_t getBytes() const;
+private:
+    size_t capacity;
+    std::mutex mutex;
+    std::condition_variable notFull, notEmpty;
+    std::deque<Frame> frames;
+    bool closed = false;
+    std::atomic_size_t bytes { 0 };
+};
+
+#endif /* SRC_MOVEVR_FRAMEQUEUE_H_ */
@@ -0,0 +1,122 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <GL/glew.h>
+#include "GLObjectPool.h"
+#include "src/Logger.h"
+
+namespace {
+    // trim() spreads the deletion of surplus objects over several calls
+    constexpr const size_t TRIM_PER_CALL = 2;
+}
+
+GLObjectPool::GLObjectPool(BindFunction bindTexture):
+    bind(bindTexture)
+{
+}
+
+void GLObjectPool::warmUp(size_t numBuffers, size_t numTextures) {
+    keepBuffers = numBuffers;
+    keepTextures = numTextures;
+
+    while (buffers.size() < keepBuffers) {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        buffers.push_back(buffer);
+    }
+
+    while (textures.size() < keepTextures) {
+        textures.push_back(createTexture());
+    }
+
+    logger::verbose("Pre-warmed %d buffers and %d textures", (int) buffers.size(), (int) textures.size());
+}
+
+void GLObjectPool::trim() {
+    for (size_t i = 0; i < TRIM_PER_CALL && buffers.size() > keepBuffers; i++) {
+        GLuint buffer = buffers.back();
+        glDeleteBuffers(1, &buffer);
+        buffers.pop_back();
+    }
+
+    for (size_t i = 0; i < TRIM_PER_CALL && textures.size() > keepTextures; i++) {
+        GLuint texture = textures.back();
+        glDeleteTextures(1, &texture);
+        textures.pop_back();
+    }
+}
+
+unsigned int GLObjectPool::acquireBuffer() {
+    if (buffers.empty()) {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        return buffer;
+    }
+
+    unsigned int buffer = buffers.back();
+    buffers.pop_back();
+    return buffer;
+}
+
+unsigned int GLObjectPool::acquireTexture() {
+    if (textures.empty()) {
+        return createTexture();
+    }
+
+    unsigned int texture = textures.back();
+    textures.pop_back();
+    return texture;
+}
+
+void GLObjectPool::releaseBuffer(unsigned int buffer) {
+    if (buffer) {
+        // orphan the storage, a pooled buffer must not keep a full frame resident
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        buffers.push_back(buffer);
+    }
+}
+
+void GLObjectPool::releaseTexture(unsigned int texture) {
+    if (texture) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        bind(texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        textures.push_back(texture);
+    }
+}
+
+unsigned int GLObjectPool::createTexture() {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    bind(texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+GLObjectPool::~GLObjectPool() {
+    for (GLuint buffer: buffers) {
+        glDeleteBuffers(1, &buffer);
+    }
+    for (GLuint texture: textures) {
+        glDeleteTextures(1, &texture);
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_GLOBJECTPOOL_H_
+#define SRC_MOVEVR_GLOBJECTPOOL_H_
+
+#include <vector>
+#include <functional>
+
+/*
+ * Keeps pre-generated buffer and texture names around so that moving a window
+ * doesn't have to create GL objects in the middle of a frame. Released objects
+ * are recycled without their storage, surplus ones are deleted a few at a time by trim().
+ * All functions must be called from the GL thread.
+ */
+class GLObjectPool {
+public:
+    using BindFunction = std::function<void(unsigned int)>;
+
+    GLObjectPool(BindFunction bindTexture);
+
+    void warmUp(size_t buffers, size_t textures);
+    void trim();
+
+    unsigned int acquireBuffer();
+    unsigned int acquireTexture();
+    void releaseBuffer(unsigned int buffer);
+    void releaseTexture(unsigned int texture);
+
+    ~GLObjectPool();
+private:
+    BindFunction bind;
+    size_t keepBuffers = 0, keepTextures = 0;
+    std::vector<unsigned int> buffers;
+    std::vector<unsigned int> textures;
+
+    unsigned int createTexture();
+};
+
+#endif /* SRC_MOVEVR_GLOBJECTPOOL_H_ */
@@ -6,9 +6,12 @@
  * Copyright (C) 2018, Christopher Collins
 */
 
+#include <GL/glew.h>
 #include <XPLM/XPLMDataAccess.h>
 #include <XPLM/XPLMDisplay.h>
 #include <XPLM/XPLMGraphics.h>
+#include <XPLM/XPLMProcessing.h>
+#include <chrono>
 #include "ImgWindow.h"
 
 static XPLMDataRef		gVrEnabledRef			= nullptr;
@@ -16,6 +19,9 @@ static XPLMDataRef		gModelviewMatrixRef		= nullptr;
 static XPLMDataRef		gViewportRef			= nullptr;
 static XPLMDataRef		gProjectionMatrixRef	= nullptr;
 
+// ImGui needs a few frames after input for hovering, popups and the like
+static const std::chrono::milliseconds	IDLE_DELAY(1000);
+
 ImgWindow::ImgWindow(
 	int left,
 	int top,
@@ -23,9 +29,21 @@ ImgWindow::ImgWindow(
 	int bottom,
 	XPLMWindowDecoration decoration,
 	XPLMWindowLayer layer) :
+    mVertexBuffer(0),
+	mIndexBuffer(0),
+	mBuffersCurrent(false),
     mSelfDestruct(false),
 	mIsInVR(false),
     mPreferredLayer(layer),
+	mLastCycle(-1),
+	mDrawsThisCycle(0),
+	mBuiltThisCycle(false),
+	mBuildMillis(0),
+	mDrawsPerCycle(1),
+	mBuildsPerCycle(1),
+	mCacheValid(false),
+	mInvalidated(true),
+	mRefreshInterval(0),
     mFirstRender(true)
 {
 	mImGuiContext = ImGui::CreateContext();
@@ -121,6 +139,11 @@ ImgWindow::configureImguiContext()
 
 ImgWindow::~ImgWindow()
 {
+	mCache.release();
+	if (mVertexBuffer) {
+		glDeleteBuffers(1, &mVertexBuffer);
+		glDeleteBuffers(1, &mIndexBuffer);
+	}
 	glDeleteTextures(1, &mFontTexture);
 	ImGui::DestroyContext(mImGuiContext);
 	XPLMDestroyWindow(mWindowID);
@@ -144,13 +167,30 @@ static void multMatrixVec4f(GLfloat dst[4], const GLfloat m[16], const GLfloat v
 }
 
 void
-ImgWindow::boxelsToNative(int x, int y, int &outX, int &outY)
+ImgWindow::updateScissorTransform()
 {
-	GLfloat boxelPos[4] = { (GLfloat)x, (GLfloat)y, 0, 1 };
-	GLfloat eye[4], ndc[4];
+	// combine the matrices once instead of running both for every corner
+	GLfloat mvp[16];
+	for (int col = 0; col < 4; col++) {
+		multMatrixVec4f(&mvp[col * 4], mProjection, &mModelView[col * 4]);
+	}
 
-	multMatrixVec4f(eye, mModelView, boxelPos);
-	multMatrixVec4f(ndc, mProjection, eye);
+	// ImGui's origin is the top left corner and its Y axis points down
+	GLfloat origin[4] = { (GLfloat)mLeft, (GLfloat)mTop, 0, 1 };
+	multMatrixVec4f(mScissorOrigin, mvp, origin);
+	for (int i = 0; i < 4; i++) {
+		mScissorX[i] = mvp[i];
+		mScissorY[i] = -mvp[4 + i];
+	}
+}
+
+void
+ImgWindow::imguiToNative(float x, float y, int &outX, int &outY)
+{
+	GLfloat ndc[4];
+	for (int i = 0; i < 4; i++) {
+		ndc[i] = mScissorOrigin[i] + x * mScissorX[i] + y * mScissorY[i];
+	}
 	ndc[3] = 1.0f / ndc[3];
 	ndc[0] *= ndc[3];
 	ndc[1] *= ndc[3];
@@ -160,13 +200,41 @@ ImgWindow::boxelsToNative(int x, int y, int &outX, int &outY)
 }
 
 void
-ImgWindow::RenderImGui(ImDrawData *draw_data)
+ImgWindow::uploadDrawData(ImDrawData *draw_data)
 {
-	// Avoid rendering when minimized, scale coordinates for retina displays (screen coordinates != framebuffer coordinates)
-	ImGuiIO& io = ImGui::GetIO();
-	draw_data->ScaleClipRects(io.DisplayFramebufferScale);
+	if (!mVertexBuffer) {
+		glGenBuffers(1, &mVertexBuffer);
+		glGenBuffers(1, &mIndexBuffer);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
 
-	updateMatrices();
+	// orphan the old storage so that we don't wait for draws that still use it
+	glBufferData(GL_ARRAY_BUFFER, draw_data->TotalVtxCount * sizeof(ImDrawVert), nullptr, GL_STREAM_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, draw_data->TotalIdxCount * sizeof(ImDrawIdx), nullptr, GL_STREAM_DRAW);
+
+	GLintptr vtxOffset = 0, idxOffset = 0;
+	for (int n = 0; n < draw_data->CmdListsCount; n++)
+	{
+		const ImDrawList* cmd_list = draw_data->CmdLists[n];
+		GLsizeiptr vtxSize = cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+		GLsizeiptr idxSize = cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+		glBufferSubData(GL_ARRAY_BUFFER, vtxOffset, vtxSize, cmd_list->VtxBuffer.Data);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, idxOffset, idxSize, cmd_list->IdxBuffer.Data);
+		vtxOffset += vtxSize;
+		idxOffset += idxSize;
+	}
+
+	mBuffersCurrent = true;
+}
+
+void
+ImgWindow::RenderImGui(ImDrawData *draw_data)
+{
+	// the clip rects were already scaled when the frame was built and the
+	// caller has set up the matrices for the target we're rendering into.
+	updateScissorTransform();
 
 	// We are using the OpenGL fixed pipeline because messing with the
 	// shader-state in X-Plane is not very well documented, but using the fixed
@@ -183,20 +251,27 @@ ImgWindow::RenderImGui(ImDrawData *draw_data)
 	glEnableClientState(GL_COLOR_ARRAY);
 	glEnable(GL_TEXTURE_2D);
 
+	// the vertices are only sent once per built frame, replays reuse them
+	if (mBuffersCurrent) {
+		glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+	} else {
+		uploadDrawData(draw_data);
+	}
+
 	glMatrixMode(GL_PROJECTION);
 	glPushMatrix();
 	glScalef(1.0f, -1.0f, 1.0f);
 	glTranslatef(static_cast<GLfloat>(mLeft), static_cast<GLfloat>(-mTop), 0.0f);
 
-	// Render command lists
+	// Render command lists, the pointers are offsets into the buffer objects now
+	intptr_t vtxOffset = 0, idxOffset = 0;
 	for (int n = 0; n < draw_data->CmdListsCount; n++)
 	{
 		const ImDrawList* cmd_list = draw_data->CmdLists[n];
-		const ImDrawVert* vtx_buffer = cmd_list->VtxBuffer.Data;
-		const ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;
-		glVertexPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)((const char*)vtx_buffer + IM_OFFSETOF(ImDrawVert, pos)));
-		glTexCoordPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)((const char*)vtx_buffer + IM_OFFSETOF(ImDrawVert, uv)));
-		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ImDrawVert), (const GLvoid*)((const char*)vtx_buffer + IM_OFFSETOF(ImDrawVert, col)));
+		glVertexPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)(vtxOffset + IM_OFFSETOF(ImDrawVert, pos)));
+		glTexCoordPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)(vtxOffset + IM_OFFSETOF(ImDrawVert, uv)));
+		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ImDrawVert), (const GLvoid*)(vtxOffset + IM_OFFSETOF(ImDrawVert, col)));
 
 		for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
 		{
@@ -206,24 +281,23 @@ ImgWindow::RenderImGui(ImDrawData *draw_data)
 			} else {
 				glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
 
-				// Scissors work in viewport space - must translate the coordinates from ImGui -> Boxels, then Boxels -> Native.
-				//FIXME: it must be possible to apply the scale+transform manually to the projection matrix so we don't need to doublestep.
-				int bTop, bLeft, bRight, bBottom;
-				translateImguiToBoxel(pcmd->ClipRect.x, pcmd->ClipRect.y, bLeft, bTop);
-				translateImguiToBoxel(pcmd->ClipRect.z, pcmd->ClipRect.w, bRight, bBottom);
+				// Scissors work in viewport space - the transform from ImGui space was prepared above
 				int nTop, nLeft, nRight, nBottom;
-				boxelsToNative(bLeft, bTop, nLeft, nTop);
-				boxelsToNative(bRight, bBottom, nRight, nBottom);
+				imguiToNative(pcmd->ClipRect.x, pcmd->ClipRect.y, nLeft, nTop);
+				imguiToNative(pcmd->ClipRect.z, pcmd->ClipRect.w, nRight, nBottom);
 				glScissor(nLeft, nBottom, nRight-nLeft, nTop-nBottom);
-				glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer);
+				glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (const GLvoid*)idxOffset);
 			}
-			idx_buffer += pcmd->ElemCount;
+			idxOffset += pcmd->ElemCount * sizeof(ImDrawIdx);
 		}
+		vtxOffset += cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
 	}
 
 	glMatrixMode(GL_PROJECTION);
 	glPopMatrix();
 	// Restore modified state
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glDisableClientState(GL_COLOR_ARRAY);
 	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -300,16 +374,153 @@ ImgWindow::updateImgui()
 }
 
 void
-ImgWindow::DrawWindowCB(XPLMWindowID /* inWindowID */, void *inRefcon)
+ImgWindow::beginCycle(int cycle)
 {
-	auto *thisWindow = reinterpret_cast<ImgWindow *>(inRefcon);
+	if (mLastCycle >= 0) {
+		mDrawsPerCycle = 0.9f * mDrawsPerCycle + 0.1f * mDrawsThisCycle;
+		mBuildsPerCycle = 0.9f * mBuildsPerCycle + (mBuiltThisCycle ? 0.1f : 0.0f);
+	}
+	mLastCycle = cycle;
+	mDrawsThisCycle = 0;
+	mBuiltThisCycle = false;
+}
 
-	thisWindow->updateImgui();
+bool
+ImgWindow::needsBuild()
+{
+	if (!mCacheValid || mInvalidated) {
+		return true;
+	}
 
-	ImGui::SetCurrentContext(thisWindow->mImGuiContext);
+	int left, top, right, bottom;
+	XPLMGetWindowGeometry(mWindowID, &left, &top, &right, &bottom);
+	if (left != mLeft || top != mTop || right != mRight || bottom != mBottom) {
+		return true;
+	}
+
+	// a text field has a blinking cursor, held buttons can drag
+	auto &io = ImGui::GetIO();
+	if (io.WantTextInput || ImGui::IsAnyMouseDown()) {
+		return true;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	if (now - mLastActivity < IDLE_DELAY) {
+		return true;
+	}
+
+	if (mRefreshInterval > 0) {
+		std::chrono::duration<float> sinceBuild = now - mLastBuild;
+		if (sinceBuild.count() >= mRefreshInterval) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+ImgWindow::buildFrame()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	updateImgui();
+
+	ImGui::SetCurrentContext(mImGuiContext);
 	ImGui::Render();
 
-	thisWindow->RenderImGui(ImGui::GetDrawData());
+	ImGuiIO& io = ImGui::GetIO();
+	ImDrawData *drawData = ImGui::GetDrawData();
+	drawData->ScaleClipRects(io.DisplayFramebufferScale);
+	mBuffersCurrent = false;
+
+	mCacheValid = renderToCache(drawData);
+	mInvalidated = false;
+	mBuiltThisCycle = true;
+	mLastBuild = std::chrono::steady_clock::now();
+
+	std::chrono::duration<float, std::milli> took = mLastBuild - start;
+	mBuildMillis = 0.9f * mBuildMillis + 0.1f * took.count();
+}
+
+bool
+ImgWindow::renderToCache(ImDrawData *draw_data)
+{
+	int width = mRight - mLeft;
+	int height = mTop - mBottom;
+	if (!mCache.resize(width, height)) {
+		return false;
+	}
+
+	mCache.begin();
+
+	// map the window's boxels 1:1 onto the texture, the scissor math then
+	// works in texture pixels instead of screen pixels.
+	for (int i = 0; i < 16; i++) {
+		mModelView[i] = mProjection[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+	}
+	mProjection[0] = 2.0f / width;
+	mProjection[5] = 2.0f / height;
+	mProjection[10] = -1.0f;
+	mProjection[12] = -(float)(mRight + mLeft) / width;
+	mProjection[13] = -(float)(mTop + mBottom) / height;
+	mViewport[0] = 0;
+	mViewport[1] = 0;
+	mViewport[2] = width;
+	mViewport[3] = height;
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadMatrixf(mProjection);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadMatrixf(mModelView);
+
+	RenderImGui(draw_data);
+
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+
+	mCache.end();
+	return true;
+}
+
+void
+ImgWindow::markActivity()
+{
+	mLastActivity = std::chrono::steady_clock::now();
+}
+
+void
+ImgWindow::DrawWindowCB(XPLMWindowID /* inWindowID */, void *inRefcon)
+{
+	auto *thisWindow = reinterpret_cast<ImgWindow *>(inRefcon);
+
+	// In VR, we're called once per eye. The interface can't change between the
+	// eyes, so it's only built for the first call of a sim frame. It's not built
+	// at all while the window is idle, the cached texture is drawn instead.
+	ImGui::SetCurrentContext(thisWindow->mImGuiContext);
+	int cycle = XPLMGetCycleNumber();
+	if (cycle != thisWindow->mLastCycle) {
+		thisWindow->beginCycle(cycle);
+		if (thisWindow->needsBuild()) {
+			thisWindow->buildFrame();
+		}
+	}
+	thisWindow->mDrawsThisCycle++;
+
+	if (thisWindow->mCacheValid) {
+		thisWindow->mCache.draw(thisWindow->mLeft, thisWindow->mTop, thisWindow->mRight, thisWindow->mBottom);
+	} else {
+		// no framebuffer support: render the draw lists, they stay valid until the next NewFrame()
+		ImDrawData *drawData = ImGui::GetDrawData();
+		if (drawData) {
+			thisWindow->updateMatrices();
+			thisWindow->RenderImGui(drawData);
+		}
+	}
 
 	if (thisWindow->mSelfDestruct) {
 		delete thisWindow;
@@ -328,6 +539,7 @@ ImgWindow::HandleMouseClickGeneric(int x, int y, XPLMMouseStatus inMouse, int bu
 {
 	ImGui::SetCurrentContext(mImGuiContext);
 	ImGuiIO& io = ImGui::GetIO();
+	markActivity();
 
     float outX, outY;
     translateToImguiSpace(x, y, outX, outY);
@@ -361,6 +573,7 @@ ImgWindow::HandleKeyFuncCB(
 	auto *thisWindow = reinterpret_cast<ImgWindow *>(inRefcon);
 	ImGui::SetCurrentContext(thisWindow->mImGuiContext);
 	ImGuiIO& io = ImGui::GetIO();
+	thisWindow->markActivity();
 	if (io.WantCaptureKeyboard) {
 		auto vk = static_cast<unsigned char>(inVirtualKey);
 		io.KeysDown[vk] = (inFlags & xplm_DownFlag) == xplm_DownFlag;
@@ -390,6 +603,10 @@ ImgWindow::HandleCursorFuncCB(
 	ImGuiIO& io = ImGui::GetIO();
 	float outX, outY;
 	thisWindow->translateToImguiSpace(x, y, outX, outY);
+	// we're called every frame while the mouse is over the window, only movement counts as activity
+	if (io.MousePos.x != outX || io.MousePos.y != outY) {
+		thisWindow->markActivity();
+	}
 	io.MousePos = ImVec2(outX, outY);
 	//FIXME: Maybe we can support imgui's cursors a bit better?
 	return xplm_CursorDefault;
@@ -407,6 +624,7 @@ ImgWindow::HandleMouseWheelFuncCB(
 	auto *thisWindow = reinterpret_cast<ImgWindow *>(inRefcon);
 	ImGui::SetCurrentContext(thisWindow->mImGuiContext);
 	ImGuiIO& io = ImGui::GetIO();
+	thisWindow->markActivity();
 
 	float outX, outY;
     thisWindow->translateToImguiSpace(x, y, outX, outY);
@@ -493,3 +711,36 @@ ImgWindow::SafeDelete()
 {
 	mSelfDestruct = true;
 }
+
+void
+ImgWindow::Invalidate()
+{
+	mInvalidated = true;
+}
+
+void
+ImgWindow::SetRefreshInterval(float seconds)
+{
+	mRefreshInterval = seconds;
+}
+
+float
+ImgWindow::GetBuildMillis() const
+{
+	return mBuildMillis * mBuildsPerCycle;
+}
+
+size_t
+ImgWindow::GetCacheBytes() const
+{
+	return mCache.getMemoryUsage();
+}
+
+float
+ImgWindow::GetSavedMillis() const
+{
+	if (mDrawsPerCycle <= mBuildsPerCycle) {
+		return 0;
+	}
+	return mBuildMillis * (mDrawsPerCycle - mBuildsPerCycle);
+}
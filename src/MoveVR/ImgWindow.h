@@ -10,9 +10,11 @@
 #define IMGWINDOW_H
 
 #include <GL/glu.h>
+#include <chrono>
 #include <string>
 #include <XPLM/XPLMDisplay.h>
 #include "imgui.h"
+#include "RenderTarget.h"
 
 /** ImgWindow is a Window for creating dear imgui widgets within.
  *
@@ -85,9 +87,23 @@ private:
 
     void updateImgui();
 
+    void beginCycle(int cycle);
+
+    bool needsBuild();
+
+    void buildFrame();
+
+    bool renderToCache(ImDrawData *draw_data);
+
+    void markActivity();
+
     void updateMatrices();
 
-    void boxelsToNative(int x, int y, int &outX, int &outY);
+    void uploadDrawData(ImDrawData *draw_data);
+
+    void updateScissorTransform();
+
+    void imguiToNative(float x, float y, int &outX, int &outY);
 
     void translateImguiToBoxel(float inX, float inY, int &outX, int &outY);
 
@@ -95,6 +111,13 @@ private:
 
     float mModelView[16], mProjection[16];
     int mViewport[4];
+    // maps ImGui coordinates straight to clip space for the scissor rects
+    float mScissorOrigin[4], mScissorX[4], mScissorY[4];
+
+    // the draw lists are streamed into these once per built frame
+    GLuint mVertexBuffer;
+    GLuint mIndexBuffer;
+    bool mBuffersCurrent;
     bool mSelfDestruct;
 
     std::string mWindowTitle;
@@ -111,6 +134,22 @@ private:
 
     XPLMWindowLayer mPreferredLayer;
 
+    // in VR, the window is drawn once per eye but only built once per sim frame
+    int mLastCycle;
+    int mDrawsThisCycle;
+    bool mBuiltThisCycle;
+    float mBuildMillis;
+    float mDrawsPerCycle;
+    float mBuildsPerCycle;
+
+    // while nothing changes, the last frame is drawn from a texture
+    RenderTarget mCache;
+    bool mCacheValid;
+    bool mInvalidated;
+    float mRefreshInterval;
+    std::chrono::steady_clock::time_point mLastActivity;
+    std::chrono::steady_clock::time_point mLastBuild;
+
 protected:
     /** mFirstRender can be checked during buildInterface() to see if we're
      * being rendered for the first time or not.  This is particularly
@@ -189,6 +228,24 @@ protected:
      */
     void SafeDelete();
 
+    /** SetRefreshInterval() makes an idle window rebuild its interface at
+     * least every few seconds, e.g. to keep displayed values current.
+     *
+     * @param seconds the interval, 0 to only rebuild on input or Invalidate().
+     */
+    void SetRefreshInterval(float seconds);
+
+    /** GetBuildMillis() returns the average time spent building the interface
+     * and its draw lists, in milliseconds per sim frame.
+     */
+    float GetBuildMillis() const;
+
+    /** GetSavedMillis() returns how many milliseconds per sim frame are saved
+     * by drawing the last frame again instead of building it again, e.g. for
+     * the second eye in VR or while the window is idle.
+     */
+    float GetSavedMillis() const;
+
 public:
     virtual ~ImgWindow();
 
@@ -205,6 +262,16 @@ public:
      * @return true if the window is visible, false otherwise.
     */
     bool GetVisible() const;
+
+    /** Invalidate() makes the window rebuild its interface on the next frame.
+     * Without input, the window is only drawn from a cached texture, so this
+     * must be called when the displayed content changes.
+     */
+    void Invalidate();
+
+    /** GetCacheBytes() returns the video memory used by the cached frame.
+     */
+    size_t GetCacheBytes() const;
 };
 
 #endif // #ifndef IMGWINDOW_H
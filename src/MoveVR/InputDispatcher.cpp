@@ -0,0 +1,116 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "InputDispatcher.h"
+#include "src/Logger.h"
+
+InputDispatcher::InputDispatcher(std::shared_ptr<Window> window):
+    wnd(window)
+{
+}
+
+void InputDispatcher::start() {
+    thread = std::make_unique<std::thread>(&InputDispatcher::dispatchLoop, this);
+}
+
+void InputDispatcher::push(Type type, int x, int y, int clicks) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // merge with the last event if it is still waiting, keeping its queue time
+    if (!queue.empty() && queue.back().type == type) {
+        Event &last = queue.back();
+        if (type == Type::DRAG) {
+            last.x = x;
+            last.y = y;
+            return;
+        } else if (type == Type::WHEEL) {
+            last.x = x;
+            last.y = y;
+            last.clicks += clicks;
+            return;
+        }
+    }
+
+    queue.push_back(Event {type, x, y, clicks, std::chrono::steady_clock::now()});
+    condition.notify_one();
+}
+
+void InputDispatcher::dispatchLoop() {
+    while (true) {
+        Event event;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return !keepRunning || !queue.empty(); });
+            // pending events are still dispatched on shutdown, a dropped release would leave the button pressed
+            if (queue.empty()) {
+                break;
+            }
+            event = queue.front();
+            queue.pop_front();
+        }
+
+        auto waited = std::chrono::steady_clock::now() - event.queueTime;
+        float latency = std::chrono::duration<float, std::milli>(waited).count();
+        averageLatency = averageLatency * 0.9f + latency * 0.1f;
+        if (latency > maxLatency) {
+            maxLatency = latency;
+        }
+
+        try {
+            dispatch(event);
+        } catch (const std::exception &e) {
+            logger::warn("Couldn't dispatch input: %s", e.what());
+        }
+    }
+}
+
+void InputDispatcher::dispatch(const Event &event) {
+    switch (event.type) {
+    case Type::DOWN:
+        wnd->onMouseDown(event.x, event.y);
+        break;
+    case Type::DRAG:
+        wnd->onMouseDrag(event.x, event.y);
+        break;
+    case Type::UP:
+        wnd->onMouseUp(event.x, event.y);
+        break;
+    case Type::WHEEL:
+        wnd->onWheel(event.x, event.y, event.clicks);
+        break;
+    }
+}
+
+float InputDispatcher::getAverageLatency() {
+    return averageLatency;
+}
+
+float InputDispatcher::getMaxLatency() {
+    return maxLatency;
+}
+
+InputDispatcher::~InputDispatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        keepRunning = false;
+    }
+    condition.notify_one();
+
+    if (thread) {
+        thread->join();
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_INPUTDISPATCHER_H_
+#define SRC_MOVEVR_INPUTDISPATCHER_H_
+
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "src/windows/Window.h"
+
+/*
+ * Forwards mouse input to a window from a thread of its own so that a hung application can't
+ * stall the simulator. Consecutive drags and wheel ticks are merged while they wait in the queue,
+ * button presses and releases are never merged or reordered.
+ */
+class InputDispatcher {
+public:
+    enum class Type {
+        DOWN,
+        DRAG,
+        UP,
+        WHEEL,
+    };
+
+    InputDispatcher(std::shared_ptr<Window> window);
+    // spawns the dispatching thread, events pushed before are queued until then
+    void start();
+
+    void push(Type type, int x, int y, int clicks = 0);
+
+    // time between queueing and dispatching an event, in milliseconds
+    float getAverageLatency();
+    float getMaxLatency();
+
+    ~InputDispatcher();
+private:
+    struct Event {
+        Type type;
+        int x, y;
+        int clicks;
+        std::chrono::steady_clock::time_point queueTime;
+    };
+
+    std::shared_ptr<Window> wnd;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Event> queue;
+    bool keepRunning = true;
+    std::unique_ptr<std::thread> thread;
+
+    std::atomic<float> averageLatency { 0 };
+    std::atomic<float> maxLatency { 0 };
+
+    void dispatchLoop();
+    void dispatch(const Event &event);
+};
+
+#endif /* SRC_MOVEVR_INPUTDISPATCHER_H_ */
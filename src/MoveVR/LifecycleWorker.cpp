@@ -0,0 +1,106 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LifecycleWorker.h"
+#include "src/Logger.h"
+
+namespace {
+    constexpr const std::chrono::milliseconds ADOPTED_POLL_INTERVAL(10);
+}
+
+LifecycleWorker::LifecycleWorker() {
+    thread = std::make_unique<std::thread>(&LifecycleWorker::workLoop, this);
+}
+
+void LifecycleWorker::post(Task task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(std::move(task));
+    condition.notify_one();
+}
+
+void LifecycleWorker::workLoop() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return !keepRunning || !queue.empty(); });
+            // pending tasks are still run on shutdown so that no thread is left unjoined
+            if (queue.empty()) {
+                break;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        try {
+            task();
+        } catch (const std::exception &e) {
+            logger::warn("Lifecycle task failed: %s", e.what());
+        }
+
+        joinFinished();
+    }
+}
+
+void LifecycleWorker::adopt(std::thread thread, FinishedCheck hasFinished) {
+    std::lock_guard<std::mutex> lock(adoptedMutex);
+    adopted.push_back(Adopted {std::move(thread), std::move(hasFinished)});
+}
+
+size_t LifecycleWorker::joinFinished() {
+    std::lock_guard<std::mutex> lock(adoptedMutex);
+    for (auto it = adopted.begin(); it != adopted.end(); ) {
+        if (it->hasFinished()) {
+            it->thread.join();
+            it = adopted.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return adopted.size();
+}
+
+bool LifecycleWorker::shutdown(std::chrono::milliseconds timeout) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        keepRunning = false;
+        condition.notify_one();
+    }
+    if (thread) {
+        thread->join();
+        thread.reset();
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (joinFinished() > 0) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            std::lock_guard<std::mutex> lock(adoptedMutex);
+            logger::warn("%d threads are still stuck in hung applications", (int) adopted.size());
+            for (auto &entry: adopted) {
+                entry.thread.detach();
+            }
+            adopted.clear();
+            return false;
+        }
+        std::this_thread::sleep_for(ADOPTED_POLL_INTERVAL);
+    }
+    return true;
+}
+
+LifecycleWorker::~LifecycleWorker() {
+    shutdown(std::chrono::milliseconds(0));
+}
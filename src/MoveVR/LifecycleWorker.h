@@ -0,0 +1,72 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_LIFECYCLEWORKER_H_
+#define SRC_MOVEVR_LIFECYCLEWORKER_H_
+
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <vector>
+#include <chrono>
+
+/*
+ * Runs the expensive parts of creating and closing moved windows, e.g. starting
+ * and joining their threads, so that the simulator thread doesn't have to wait.
+ * Tasks run in the order they were posted. Must not be used for GL calls.
+ * Threads that can't be joined, e.g. because they are stuck in a hung application,
+ * are adopted and joined once they finish.
+ */
+class LifecycleWorker {
+public:
+    using Task = std::function<void()>;
+
+    using FinishedCheck = std::function<bool()>;
+
+    LifecycleWorker();
+    void post(Task task);
+    // hasFinished must return true once the thread is about to return
+    void adopt(std::thread thread, FinishedCheck hasFinished);
+
+    // runs the pending tasks and waits for the adopted threads, returns false if some are still running
+    bool shutdown(std::chrono::milliseconds timeout);
+
+    ~LifecycleWorker();
+private:
+    struct Adopted {
+        std::thread thread;
+        FinishedCheck hasFinished;
+    };
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Task> queue;
+    bool keepRunning = true;
+    std::unique_ptr<std::thread> thread;
+
+    std::mutex adoptedMutex;
+    std::vector<Adopted> adopted;
+
+    void workLoop();
+    // returns the number of adopted threads that are still running
+    size_t joinFinished();
+};
+
+#endif /* SRC_MOVEVR_LIFECYCLEWORKER_H_ */
@@ -20,11 +20,17 @@
 #include "src/Logger.h"
 #include "ManagerWidget.h"
 
+namespace {
+    constexpr const float REFRESH_INTERVAL = 1.0f;
+}
+
 ManagerWidget::ManagerWidget(std::shared_ptr<WindowManager> mgr, int left, int top, int right, int bot):
     ImgWindow(left, top, right, bot),
     manager(mgr)
 {
     SetWindowTitle("MoveVR " MOVEVR_VERSION " by Folke Will");
+    // the statistics and window lists change without input
+    SetRefreshInterval(REFRESH_INTERVAL);
     SetVisible(true);
 }
 
@@ -34,16 +40,47 @@ void ManagerWidget::buildInterface() {
                 "MoveVR " MOVEVR_VERSION ", copyright 2018 by Folke Will <folko@solhost.org>\n"
                 "Uses the X-Plane imgui integration library, copyright 2018 by Christopher Collins\n"
                 "\n"
-                "Make sure your original windows are about the same size as you need them in VR.\n"
+                "Make sure your original windows are about the same size as you need them in VR,\n"
+                "or let MoveVR resize them to the VR size to avoid expensive scaling.\n"
                 "Increasing the delay slider improves X-Plane's frame rate by slower capturing.\n"
                 "Only use a higher quality setting if you really need it as it is rather expensive (FPS).\n"
                 "Only enable mouse dragging if you are using an application that needs dragging or panning.\n"
+                "Crop windows to the part you need in VR, the capture cost scales with the cropped area.\n"
+                "Shared desktop capture is cheaper for many windows, but also captures windows covering them.\n"
+                "Windows that weren't used recently are captured at lower resolutions when over the memory budget.\n"
+                "VR windows are suspended when leaving VR and restored when entering it, even after a restart.\n"
+                "Plugin windows with a panel region only receive VR clicks inside it, others receive all panel clicks.\n"
+                "The plugin profiler shows which plugins' windows take the most time to draw.\n"
+                "Cached plugin windows are drawn once for both eyes, or only every few frames.\n"
+                "Smooth video playback evens out the frame rate of videos and moving maps, but adds some latency.\n"
+                "Uploading frames on a separate thread takes load off X-Plane's frame, it applies to newly moved windows.\n"
                 "";
         ImGui::Text("%s", text);
 
         ImGui::TreePop();
     }
 
+    bool release = manager->getReleaseOnSuspend();
+    if (ImGui::Checkbox("Release Video Memory of Suspended Windows", &release)) {
+        manager->setReleaseOnSuspend(release);
+    }
+
+    bool sharedUpload = manager->getSharedUpload();
+    if (ImGui::Checkbox("Upload Frames on a Separate Thread", &sharedUpload)) {
+        manager->setSharedUpload(sharedUpload);
+    }
+
+    auto budget = manager->getMemoryBudget();
+    auto usage = budget->getUsage();
+    int budgetMB = budget->getBudget() / (1024 * 1024);
+    if (ImGui::SliderInt("Memory Budget (MB)", &budgetMB, 64, 4096)) {
+        budget->setBudget((size_t) budgetMB * 1024 * 1024);
+    }
+    ImGui::Text("Memory usage: %.1f MB video, %.1f MB system",
+            usage.gpuBytes / (1024.0f * 1024.0f), usage.hostBytes / (1024.0f * 1024.0f));
+    ImGui::Text("Interface: %.2f ms per frame, %.2f ms saved by caching it",
+            GetBuildMillis(), GetSavedMillis());
+
     if (ImGui::TreeNode("Plugin Windows")) {
         buildXPlaneWindows();
         ImGui::TreePop();
@@ -53,6 +90,35 @@ void ManagerWidget::buildInterface() {
         buildSystemWindows();
         ImGui::TreePop();
     }
+
+    if (ImGui::TreeNode("Plugin Profiler")) {
+        buildProfiler();
+        ImGui::TreePop();
+    }
+}
+
+void ManagerWidget::buildProfiler() {
+    auto profiler = manager->getPluginProfiler();
+
+    bool enabled = profiler->isEnabled();
+    if (ImGui::Checkbox("Profile Plugin Windows", &enabled)) {
+        profiler->setEnabled(enabled);
+    }
+
+    if (!enabled) {
+        return;
+    }
+
+    ImGui::TextDisabled("Milliseconds per frame, average / 99th percentile");
+    for (auto &entry: profiler->getStats()) {
+        char name[512];
+        XPLMGetPluginInfo(entry.first, name, nullptr, nullptr, nullptr);
+        auto &stats = entry.second;
+        ImGui::Text("%s: draw %.2f / %.2f, click %.2f / %.2f, cursor %.2f / %.2f", name,
+                stats.draw.average, stats.draw.p99,
+                stats.click.average, stats.click.p99,
+                stats.cursor.average, stats.cursor.p99);
+    }
 }
 
 void ManagerWidget::buildXPlaneWindows() {
@@ -95,7 +161,46 @@ void ManagerWidget::buildXPlaneWindow(XPLMWindowID wnd) {
             manager->addTriggerReceiver(wnd);
         } else {
             manager->removeTriggerReceiver(wnd);
+            panelRegionInput.erase(wnd);
+        }
+    }
+
+    if (isReceiver) {
+        // kept here as well, incomplete regions aren't stored by the manager
+        auto it = panelRegionInput.find(wnd);
+        if (it == panelRegionInput.end()) {
+            it = panelRegionInput.insert(std::make_pair(wnd, manager->getTriggerRegion(wnd))).first;
+        }
+        auto &region = it->second;
+        int values[4] = {region.x, region.y, region.width, region.height};
+        if (ImGui::InputInt4("Panel Region (x, y, w, h)", values)) {
+            region.x = values[0];
+            region.y = values[1];
+            region.width = values[2];
+            region.height = values[3];
+            manager->setTriggerRegion(wnd, region);
+        }
+    }
+
+    auto cache = manager->getPluginWindowCache();
+    bool cached = cache->isEnabled(wnd);
+    int interval = cache->getInterval(wnd);
+    if (ImGui::Checkbox("Cache Drawing", &cached)) {
+        try {
+            if (cached) {
+                cache->enable(wnd, interval);
+            } else {
+                cache->disable(wnd);
+            }
+        } catch (const std::exception &e) {
+            logger::warn("Can't cache window: %s", e.what());
+        }
+    }
+    if (cached) {
+        if (ImGui::SliderInt("Redraw Interval", &interval, 1, 30, "every %.0f frames")) {
+            cache->enable(wnd, interval);
         }
+        ImGui::Text("Saving %.2f ms per frame", cache->getSavedMillis(wnd));
     }
 
     if (ImGui::Button("Enable VR for legacy windows")) {
@@ -118,7 +223,12 @@ void ManagerWidget::buildXPlaneWindow(XPLMWindowID wnd) {
 void ManagerWidget::buildSystemWindows() {
     manager->forEachWindow([this] (std::shared_ptr<Window> wnd) {
         ImGui::PushID(wnd.get());
-        if (ImGui::TreeNode(wnd->getTitle().c_str())) {
+        auto meta = wnd->getMetadata();
+        if (ImGui::TreeNode(meta->title.c_str())) {
+            if (!meta->processName.empty()) {
+                ImGui::TextDisabled("%s, %dx%d", meta->processName.c_str(), meta->width, meta->height);
+            }
+
             auto &config = windowConfig[wnd];
             auto moved = manager->findMovedWindow(wnd);
 
@@ -126,6 +236,12 @@ void ManagerWidget::buildSystemWindows() {
                 config.brightness = moved->getBrightness();
                 config.delay = moved->getDelay();
                 config.dragging = moved->getDoDrag();
+                config.crop = moved->getCropRegion();
+                config.trimBorders = moved->getTrimBorders();
+                config.autoResize = moved->getAutoResize();
+                config.sharedCapture = moved->hasDesktopCapture();
+                config.showCursor = moved->getShowCursor();
+                config.smoothPlayback = moved->getSmoothPlayback();
             }
 
             if (ImGui::SliderInt("", &config.delay, 0, 20, "Delay: %.0f frames")) {
@@ -146,15 +262,83 @@ void ManagerWidget::buildSystemWindows() {
                 }
             }
 
+            if (ImGui::Checkbox("Show Mouse Cursor", &config.showCursor)) {
+                if (moved) {
+                    moved->setShowCursor(config.showCursor);
+                }
+            }
+
+            if (ImGui::Checkbox("Smooth Video Playback", &config.smoothPlayback)) {
+                if (moved) {
+                    moved->setSmoothPlayback(config.smoothPlayback);
+                }
+            }
+
+            if (ImGui::Checkbox("Trim Borders and Title Bar", &config.trimBorders)) {
+                if (moved) {
+                    moved->setTrimBorders(config.trimBorders);
+                }
+            }
+
+            if (ImGui::Checkbox("Resize Original Window to VR Size", &config.autoResize)) {
+                if (moved) {
+                    moved->setAutoResize(config.autoResize);
+                }
+            }
+
+            if (ImGui::Checkbox("Shared Desktop Capture", &config.sharedCapture)) {
+                if (moved) {
+                    moved->setDesktopCapture(config.sharedCapture ? manager->getDesktopCapture() : nullptr);
+                }
+            }
+
+            int crop[4] = {config.crop.x, config.crop.y, config.crop.width, config.crop.height};
+            if (ImGui::InputInt4("Crop (x, y, w, h)", crop)) {
+                config.crop.x = crop[0];
+                config.crop.y = crop[1];
+                config.crop.width = crop[2];
+                config.crop.height = crop[3];
+                if (moved) {
+                    moved->setCropRegion(config.crop);
+                }
+            }
+            if (config.autoResize && !config.crop.isEmpty()) {
+                ImGui::TextDisabled("Cropped windows aren't resized to the VR size");
+            }
+
             if (!moved) {
                 if (ImGui::Button("Move to VR")) {
                     moved = manager->moveToVR(wnd);
                     moved->setDelay(config.delay);
                     moved->setBrightness(config.brightness);
                     moved->setDoDrag(config.dragging);
+                    moved->setCropRegion(config.crop);
+                    moved->setTrimBorders(config.trimBorders);
+                    moved->setAutoResize(config.autoResize);
+                    moved->setDesktopCapture(config.sharedCapture ? manager->getDesktopCapture() : nullptr);
+                    moved->setShowCursor(config.showCursor);
+                    moved->setSmoothPlayback(config.smoothPlayback);
                 }
             } else {
-                ImGui::Text("Window is in VR");
+                if (moved->isSuspended()) {
+                    ImGui::Text("Window is suspended until you enter VR again");
+                } else {
+                    ImGui::Text("Window is in VR");
+                }
+                if (moved->getResolutionScale() < 1.0f) {
+                    ImGui::Text("Captured at %d%% resolution to stay within the memory budget",
+                            (int) (moved->getResolutionScale() * 100));
+                }
+                if (moved->isCaptureStalled()) {
+                    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Window is not responding, showing its last frame");
+                }
+                ImGui::Text("Input latency: %.2f ms average, %.2f ms max",
+                        moved->getAverageInputLatency(), moved->getMaxInputLatency());
+                auto timings = moved->getStageTimings();
+                ImGui::Text("Capture: %.2f ms, waiting for draw: %.2f ms, upload: %.2f ms",
+                        timings.capture, timings.waiting, timings.publish);
+                ImGui::Text("Frame interval: %.1f ms, jitter %.2f ms captured, %.2f ms presented",
+                        timings.interval, timings.captureJitter, timings.presentJitter);
             }
 
             ImGui::TreePop();
@@ -167,7 +351,7 @@ std::map<XPLMPluginID, std::vector<XPLMWindowID>> ManagerWidget::groupWindowsByP
     std::map<XPLMPluginID, std::vector<XPLMWindowID>> res;
 
     auto windowList = manager->getXPlaneWindows();
-    auto windows = windowList->findWindows();
+    auto &windows = windowList->getWindows();
 
     for (auto wnd: windows) {
         if (!XPLMGetWindowIsVisible(wnd)) {
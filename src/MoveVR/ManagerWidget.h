@@ -31,6 +31,12 @@ public:
         int delay = 0;
         bool dragging = false;
         float brightness = 1.0f;
+        Window::Region crop {};
+        bool trimBorders = false;
+        bool autoResize = false;
+        bool sharedCapture = false;
+        bool showCursor = true;
+        bool smoothPlayback = false;
     };
 
     ManagerWidget(std::shared_ptr<WindowManager> mgr, int left, int top, int right, int bot);
@@ -39,9 +45,11 @@ protected:
 private:
     std::shared_ptr<WindowManager> manager;
     std::map<std::shared_ptr<Window>, WindowConfig> windowConfig;
+    std::map<XPLMWindowID, PanelRegions::Region> panelRegionInput;
 
     void buildXPlaneWindows();
     void buildXPlaneWindow(XPLMWindowID wnd);
+    void buildProfiler();
 
     void buildSystemWindows();
 
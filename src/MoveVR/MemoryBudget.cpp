@@ -0,0 +1,131 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "MemoryBudget.h"
+#include "src/windows/FramePool.h"
+#include "src/Logger.h"
+
+namespace {
+    // the usage only changes after the next captures, so wait before changing anything else
+    constexpr const std::chrono::seconds CHANGE_COOLDOWN(2);
+    constexpr const float MIN_SCALE = 0.25f;
+    // only raise the resolution if there's plenty of room to avoid oscillating
+    constexpr const float UPGRADE_THRESHOLD = 0.7f;
+}
+
+void MemoryBudget::setBudget(size_t bytes) {
+    budget = bytes;
+}
+
+size_t MemoryBudget::getBudget() const {
+    return budget;
+}
+
+MemoryBudget::Usage MemoryBudget::getUsage() const {
+    return usage;
+}
+
+MemoryBudget::Usage MemoryBudget::measure(const std::vector<std::shared_ptr<MovedWindow>> &windows, size_t sharedBytes) {
+    Usage res;
+    res.hostBytes = sharedBytes;
+    for (auto &wnd: windows) {
+        auto wndUsage = wnd->getMemoryUsage();
+        res.gpuBytes += wndUsage.gpuBytes;
+        res.hostBytes += wndUsage.hostBytes;
+    }
+    return res;
+}
+
+void MemoryBudget::enforce(const std::vector<std::shared_ptr<MovedWindow>> &windows, size_t sharedBytes) {
+    usage = measure(windows, sharedBytes);
+
+    if (usage.total() > budget) {
+        // idle windows and pooled frames don't need their memory, this is free for the user
+        for (auto &wnd: windows) {
+            if (wnd->isSuspended()) {
+                wnd->releaseIdleMemory();
+            }
+        }
+        FramePool::shared().trim();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < nextChange) {
+        return;
+    }
+
+    bool changed = false;
+    if (usage.total() > budget) {
+        changed = downgrade(windows);
+    } else if (usage.total() < budget * UPGRADE_THRESHOLD) {
+        changed = upgrade(windows);
+    }
+
+    if (changed) {
+        nextChange = now + CHANGE_COOLDOWN;
+    }
+}
+
+bool MemoryBudget::downgrade(const std::vector<std::shared_ptr<MovedWindow>> &windows) {
+    // we don't know where the windows are in the cockpit, so lower the one used least recently
+    std::shared_ptr<MovedWindow> victim;
+    for (auto &wnd: windows) {
+        if (wnd->isSuspended() || wnd->getResolutionScale() <= MIN_SCALE) {
+            continue;
+        }
+        if (!victim || wnd->getLastInteraction() < victim->getLastInteraction()) {
+            victim = wnd;
+        }
+    }
+
+    if (!victim) {
+        return false;
+    }
+
+    float scale = victim->getResolutionScale() / 2;
+    victim->setResolutionScale(scale < MIN_SCALE ? MIN_SCALE : scale);
+    logger::verbose("Over memory budget (%d MB), lowering resolution to %.2f",
+            (int) (usage.total() / (1024 * 1024)), victim->getResolutionScale());
+    return true;
+}
+
+bool MemoryBudget::upgrade(const std::vector<std::shared_ptr<MovedWindow>> &windows) {
+    std::shared_ptr<MovedWindow> candidate;
+    for (auto &wnd: windows) {
+        if (wnd->isSuspended() || wnd->getResolutionScale() >= 1.0f) {
+            continue;
+        }
+        if (!candidate || wnd->getLastInteraction() > candidate->getLastInteraction()) {
+            candidate = wnd;
+        }
+    }
+
+    if (!candidate) {
+        return false;
+    }
+
+    // doubling the resolution needs four times the memory
+    auto current = candidate->getMemoryUsage();
+    size_t expected = usage.total() + 3 * (current.gpuBytes + current.hostBytes);
+    if (expected > budget * UPGRADE_THRESHOLD) {
+        return false;
+    }
+
+    float scale = candidate->getResolutionScale() * 2;
+    candidate->setResolutionScale(scale > 1.0f ? 1.0f : scale);
+    return true;
+}
@@ -0,0 +1,57 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_MEMORYBUDGET_H_
+#define SRC_MOVEVR_MEMORYBUDGET_H_
+
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include "MovedWindow.h"
+
+/*
+ * Accounts for the video and host memory of all moved windows and keeps it within a budget.
+ * When over budget, suspended windows release their buffers first, then the windows that
+ * weren't used for the longest time capture at lower resolutions. The resolution is raised
+ * again once there's enough room.
+ */
+class MemoryBudget {
+public:
+    struct Usage {
+        size_t gpuBytes = 0;
+        size_t hostBytes = 0;
+        size_t total() const { return gpuBytes + hostBytes; }
+    };
+
+    void setBudget(size_t bytes);
+    size_t getBudget() const;
+    Usage getUsage() const;
+
+    // called periodically on the GL thread, sharedBytes is memory not owned by a single window
+    void enforce(const std::vector<std::shared_ptr<MovedWindow>> &windows, size_t sharedBytes);
+private:
+    size_t budget = 512 * 1024 * 1024;
+    Usage usage;
+    std::chrono::steady_clock::time_point nextChange {};
+
+    static Usage measure(const std::vector<std::shared_ptr<MovedWindow>> &windows, size_t sharedBytes);
+    bool downgrade(const std::vector<std::shared_ptr<MovedWindow>> &windows);
+    bool upgrade(const std::vector<std::shared_ptr<MovedWindow>> &windows);
+};
+
+#endif /* SRC_MOVEVR_MEMORYBUDGET_H_ */
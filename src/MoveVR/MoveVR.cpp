@@ -20,13 +20,14 @@
 #include "MoveVR.h"
 #include "src/Logger.h"
 
-MoveVR::MoveVR():
-    windowManager(std::make_shared<WindowManager>())
+MoveVR::MoveVR(const std::string &pluginPath):
+    windowManager(std::make_shared<WindowManager>(pluginPath + "MoveVR_session.txt"))
 {
 }
 
 void MoveVR::start() {
     glewInit();
+    windowManager->warmUp();
     createMenu("MoveVR");
     command = createCommand();
 
@@ -46,10 +47,11 @@ void MoveVR::onPlaneReload() {
     if (managerWidget) {
         managerWidget->SetVisible(false);
     }
-    windowManager->closeVRWindows();
+    windowManager->onPlaneReload();
 }
 
 void MoveVR::stop() {
+    windowManager->saveSession();
     if (flightLoopId) {
         XPLMDestroyFlightLoop(flightLoopId);
         flightLoopId = {};
@@ -58,6 +60,11 @@ void MoveVR::stop() {
     destroyCommand();
 }
 
+bool MoveVR::shutdown() {
+    managerWidget.reset();
+    return windowManager->shutdown();
+}
+
 XPLMFlightLoopID MoveVR::createFlightLoop() {
     XPLMCreateFlightLoop_t loop;
     loop.structSize = sizeof(XPLMCreateFlightLoop_t);
@@ -161,6 +168,8 @@ void MoveVR::toggleWidget() {
 }
 
 float MoveVR::onFlightLoop(float elapsedSinceLastCall, float elapseSinceLastLoop, int count) {
-    windowManager->checkForClose();
+    // only picks up the latest discovery snapshot, so this is cheap enough for every loop
+    windowManager->update();
+    windowManager->checkForClose(managerWidget ? managerWidget->GetCacheBytes() : 0);
     return 0.25;
 }
@@ -28,11 +28,13 @@
 
 class MoveVR {
 public:
-    MoveVR();
+    MoveVR(const std::string &pluginPath);
     void start();
     void onVRStateChanged(bool inVr);
     void onPlaneReload();
     void stop();
+    // before unloading, returns false if some threads couldn't be stopped
+    bool shutdown();
 private:
     int subMenuIdx = -1;
     XPLMMenuID subMenu = nullptr;
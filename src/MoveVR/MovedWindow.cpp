@@ -16,24 +16,60 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <stdexcept>
-#include <chrono>
+#include <cmath>
 #include <GL/gl.h>
 #include <GL/glext.h>
 #include "MovedWindow.h"
+#include "StreamCopy.h"
 #include "src/Logger.h"
 
-MovedWindow::MovedWindow(std::shared_ptr<Window> window):
+namespace {
+    // wait until the user stops resizing the panel before resizing the original window
+    constexpr const std::chrono::milliseconds RESIZE_DEBOUNCE(500);
+
+    // captures taking longer mark the window as stalled, it then keeps showing its last frame
+    constexpr const std::chrono::milliseconds CAPTURE_DEADLINE(2000);
+    constexpr const std::chrono::milliseconds MIN_RETRY_BACKOFF(250);
+    constexpr const std::chrono::milliseconds MAX_RETRY_BACKOFF(8000);
+
+    int64_t nowMillis() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+    }
+
+    void addSample(std::atomic<float> &average, std::chrono::steady_clock::duration duration) {
+        float millis = std::chrono::duration<float, std::milli>(duration).count();
+        average = average * 0.9f + millis * 0.1f;
+    }
+}
+
+MovedWindow::MovedWindow(std::shared_ptr<Window> window, std::shared_ptr<GLObjectPool> objectPool, std::shared_ptr<LifecycleWorker> lifecycleWorker,
+        std::shared_ptr<ThreadPool> threadPool, std::shared_ptr<UploadContext> uploadContext):
     wnd(window),
+    glPool(objectPool),
+    worker(lifecycleWorker),
+    workerPool(threadPool),
+    uploader(uploadContext),
     isVrEnabled("sim/graphics/VR/enabled", false)
 {
-    initTexture();
+    input = std::make_shared<InputDispatcher>(wnd);
     createWindow(wnd->getTitle());
 
     doCapture = true;
     needRedraw = false;
 
-    keepRunning = true;
-    captureThread = std::make_unique<std::thread>(&MovedWindow::captureLoop, this);
+    capture = std::make_shared<CaptureContext>();
+    capture->owner = this;
+    capture->wnd = wnd;
+
+    // spawning the threads is left to the worker, the first frame arrives asynchronously anyway
+    auto ctx = capture;
+    auto dispatcher = input;
+    worker->post([ctx, dispatcher] {
+        dispatcher->start();
+        ctx->publisher = std::thread(&MovedWindow::publishLoop, ctx);
+        ctx->thread = std::thread(&MovedWindow::captureLoop, ctx);
+    });
 }
 
 void MovedWindow::setDelay(int dly) {
@@ -48,10 +84,121 @@ void MovedWindow::setDoDrag(bool drag) {
     doDrag = drag;
 }
 
+void MovedWindow::setCropRegion(const Window::Region &region) {
+    wnd->setCropRegion(region);
+    if (autoResize) {
+        // the window isn't resized while cropped, catch up once the crop is removed
+        scheduleSourceResize(requestedWidth, requestedHeight, false);
+    }
+}
+
+void MovedWindow::setTrimBorders(bool trim) {
+    wnd->setTrimBorders(trim);
+}
+
+void MovedWindow::setAutoResize(bool resize) {
+    if (autoResize == resize) {
+        return;
+    }
+    autoResize = resize;
+    scheduleSourceResize(requestedWidth, requestedHeight, !resize);
+}
+
+void MovedWindow::setDesktopCapture(std::shared_ptr<DesktopCapture> capture) {
+    wnd->setDesktopCapture(capture);
+    sharedCapture = (capture != nullptr);
+}
+
+void MovedWindow::setShowCursor(bool show) {
+    showCursor = show;
+}
+
+void MovedWindow::setSmoothPlayback(bool smooth) {
+    capture->pacer.setEnabled(smooth);
+    // otherwise the capture thread would wait for the held back frame and the pacer would measure its own delay
+    capture->frames.setCapacity(smooth ? 2 : 1);
+}
+
+bool MovedWindow::getSmoothPlayback() {
+    return capture->pacer.isEnabled();
+}
+
 bool MovedWindow::getDoDrag() {
     return doDrag;
 }
 
+Window::Region MovedWindow::getCropRegion() {
+    return wnd->getCropRegion();
+}
+
+bool MovedWindow::getTrimBorders() {
+    return wnd->getTrimBorders();
+}
+
+bool MovedWindow::getAutoResize() {
+    return autoResize;
+}
+
+bool MovedWindow::hasDesktopCapture() {
+    return sharedCapture;
+}
+
+bool MovedWindow::getShowCursor() {
+    return showCursor;
+}
+
+float MovedWindow::getAverageInputLatency() {
+    return input->getAverageLatency();
+}
+
+float MovedWindow::getMaxInputLatency() {
+    return input->getMaxLatency();
+}
+
+MovedWindow::StageTimings MovedWindow::getStageTimings() {
+    StageTimings timings;
+    timings.capture = capture->captureMillis;
+    timings.waiting = capture->waitMillis;
+    timings.publish = capture->publishMillis;
+    timings.interval = capture->pacer.getSourceInterval();
+    timings.captureJitter = capture->pacer.getCaptureJitter();
+    timings.presentJitter = capture->pacer.getPresentJitter();
+    return timings;
+}
+
+bool MovedWindow::isCaptureStalled() {
+    int64_t started = capture->callStarted;
+    return capture->stalled || (started != 0 && nowMillis() - started > CAPTURE_DEADLINE.count());
+}
+
+void MovedWindow::scheduleSourceResize(int width, int height, bool restore) {
+    std::lock_guard<std::mutex> lock(resizeMutex);
+    resizePending = true;
+    // a width of 0 means restoring the original geometry
+    resizeWidth = restore ? 0 : width;
+    resizeHeight = restore ? 0 : height;
+    resizeDue = std::chrono::steady_clock::now() + (restore ? std::chrono::milliseconds(0) : RESIZE_DEBOUNCE);
+}
+
+void MovedWindow::resizeSourceIfDue() {
+    int width, height;
+    {
+        std::lock_guard<std::mutex> lock(resizeMutex);
+        if (!resizePending || std::chrono::steady_clock::now() < resizeDue) {
+            return;
+        }
+        resizePending = false;
+        width = resizeWidth;
+        height = resizeHeight;
+    }
+
+    if (width > 0) {
+        wnd->resizeCaptureRegion(width, height);
+    } else {
+        wnd->restoreGeometry();
+    }
+}
+
 int MovedWindow::getDelay() {
     return drawDelay;
 }
@@ -64,12 +211,88 @@ bool MovedWindow::isShown() {
     return XPLMGetWindowIsVisible(window);
 }
 
-void MovedWindow::initTexture() {
-    if (textureId < 0) {
-        XPLMGenerateTextureNumbers(&textureId, 1);
-        XPLMBindTexture2d(textureId, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void MovedWindow::suspend() {
+    capture->suspended = true;
+    XPLMSetWindowIsVisible(window, 0);
+}
+
+void MovedWindow::resume() {
+    if (!capture->suspended) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(capture->frameMutex);
+        pbo.restoreBuffers();
+    }
+    capture->releaseStaging = false;
+
+    if (isVrEnabled) {
+        XPLMSetWindowPositioningMode(window, xplm_WindowVR, -1);
+        XPLMSetWindowGeometryVR(window, requestedWidth, requestedHeight);
+    } else {
+        XPLMSetWindowPositioningMode(window, xplm_WindowPositionFree, -1);
+    }
+    XPLMSetWindowIsVisible(window, 1);
+    capture->suspended = false;
+}
+
+bool MovedWindow::isSuspended() {
+    return capture->suspended;
+}
+
+MovedWindow::MemoryUsage MovedWindow::getMemoryUsage() {
+    MemoryUsage usage;
+    usage.gpuBytes = pbo.getGpuBytes();
+    usage.hostBytes = wnd->getStagingBytes() + capture->frames.getBytes();
+    return usage;
+}
+
+void MovedWindow::releaseIdleMemory() {
+    if (!capture->suspended) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(capture->frameMutex);
+        pbo.releaseBuffers();
+    }
+    // the staging memory belongs to the capture thread
+    capture->releaseStaging = true;
+}
+
+void MovedWindow::setResolutionScale(float scale) {
+    resolutionScale = scale;
+}
+
+float MovedWindow::getResolutionScale() {
+    return resolutionScale;
+}
+
+std::chrono::steady_clock::time_point MovedWindow::getLastInteraction() {
+    return lastInteraction;
+}
+
+int MovedWindow::getPanelWidth() {
+    return requestedWidth;
+}
+
+int MovedWindow::getPanelHeight() {
+    return requestedHeight;
+}
+
+void MovedWindow::setPanelSize(int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    // onDraw notices the new geometry and adapts the buffers and the aspect ratio
+    if (XPLMWindowIsInVR(window)) {
+        XPLMSetWindowGeometryVR(window, width, height);
+    } else {
+        int left, top, right, bottom;
+        XPLMGetWindowGeometry(window, &left, &top, &right, &bottom);
+        XPLMSetWindowGeometry(window, left, top, left + width, top - height);
     }
 }
 
@@ -78,7 +301,8 @@ void MovedWindow::createWindow(const std::string &title) {
     XPLMGetScreenBoundsGlobal(&winLeft, &winTop, &winRight, &winBot);
 
     requestedWidth = 300;
-    requestedHeight = requestedWidth * wnd->getAspectRatio();
+    shownRatio = wnd->getAspectRatio();
+    requestedHeight = requestedWidth * shownRatio;
 
     XPLMCreateWindow_t params;
     params.structSize = sizeof(params);
@@ -124,32 +348,169 @@ void MovedWindow::createWindow(const std::string &title) {
 
     XPLMSetWindowTitle(window, title.c_str());
 
-    XPLMBindTexture2d(textureId, 0);
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    pbo.init(requestedWidth, requestedHeight, (3 * requestedWidth + (4 - 1)) & ~(4 - 1));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    pbo.init(requestedWidth, requestedHeight, (3 * requestedWidth + (4 - 1)) & ~(4 - 1), [] (unsigned int tex) {
+        XPLMBindTexture2d(tex, 0);
+    }, glPool, uploader);
+    wnd->setMaxTileSize(pbo.getMaxTileSize());
+
+    auto pool = workerPool;
+    wnd->setParallelFor([pool] (size_t parts, const std::function<void(size_t)> &job) {
+        pool->parallelFor(parts, job);
+    });
 }
 
-void MovedWindow::captureLoop() {
-    while (keepRunning) {
-        auto ptr = pbo.getBackBuffer();
-        if (!ptr) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1 + drawDelay * 2));
+void MovedWindow::captureLoop(std::shared_ptr<CaptureContext> ctx) {
+    std::chrono::milliseconds backoff(0);
+    auto retryAt = std::chrono::steady_clock::now();
+
+    while (true) {
+        int delay = 0, width = 0, height = 0;
+        bool ready = false;
+        {
+            std::lock_guard<std::mutex> lock(ctx->frameMutex);
+            MovedWindow *self = ctx->owner;
+            if (!self) {
+                break;
+            }
+
+            self->resizeSourceIfDue();
+            delay = self->drawDelay;
+            // the next frame is captured while the previous one waits for the draw callback
+            ready = !ctx->suspended && std::chrono::steady_clock::now() >= retryAt;
+            if (ready) {
+                width = self->pbo.getBackbufferWidth();
+                height = self->pbo.getBackbufferHeight();
+                // from here on, the destructor won't wait for this thread anymore
+                ctx->callStarted = nowMillis();
+            }
+        }
+
+        if (!ready) {
+            if (ctx->suspended && ctx->releaseStaging.exchange(false)) {
+                ctx->frames.clear();
+                ctx->wnd->releaseStagingMemory();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1 + delay * 2));
             continue;
         }
 
-        try {
-            wnd->updateScreenshot(pbo.getBackbufferWidth(), pbo.getBackbufferHeight(), 2);
-        } catch (const std::exception &e) {
-            pbo.finishBackBuffer();
-            logger::info("No screenshot: %s", e.what());
+        auto started = std::chrono::steady_clock::now();
+        // probing costs a round trip to the application, so only do it once a capture missed its deadline
+        bool responsive = !ctx->stalled || ctx->wnd->isResponsive();
+        if (responsive) {
+            try {
+                ctx->wnd->updateScreenshot(width, height, 2);
+            } catch (const std::exception &e) {
+                ctx->callStarted = 0;
+                std::lock_guard<std::mutex> lock(ctx->frameMutex);
+                if (ctx->owner) {
+                    ctx->owner->pbo.finishBackBuffer();
+                }
+                logger::info("No screenshot: %s", e.what());
+                break;
+            }
+        }
+        auto duration = std::chrono::steady_clock::now() - started;
+        ctx->callStarted = 0;
+
+        if (!responsive || duration > CAPTURE_DEADLINE) {
+            backoff = (backoff.count() == 0) ? MIN_RETRY_BACKOFF : backoff * 2;
+            if (backoff > MAX_RETRY_BACKOFF) {
+                backoff = MAX_RETRY_BACKOFF;
+            }
+            retryAt = std::chrono::steady_clock::now() + backoff;
+
+            if (!ctx->stalled) {
+                logger::warn("Capture of '%s' stalled, retrying with backoff", ctx->wnd->getTitle().c_str());
+            }
+            ctx->stalled = true;
+
+            if (!responsive) {
+                // keep showing the last good frame
+                continue;
+            }
+        } else {
+            backoff = std::chrono::milliseconds(0);
+            ctx->stalled = false;
+        }
+
+        addSample(ctx->captureMillis, duration);
+
+        FrameQueue::Frame frame;
+        frame.shot = ctx->wnd->takeScreenshot();
+        frame.captured = std::chrono::steady_clock::now();
+        ctx->pacer.onCaptured(frame.captured);
+        // blocks while the publisher is still busy with the previous frame
+        if (!ctx->frames.push(std::move(frame))) {
             break;
         }
 
-        auto &screenshot = wnd->getLastScreenshot();
-        memcpy(ptr, screenshot.pixels.data(), screenshot.pixels.size());
-        pbo.finishBackBuffer();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1 + delay * 2));
+    }
+
+    ctx->finished = true;
+}
+
+void MovedWindow::publishLoop(std::shared_ptr<CaptureContext> ctx) {
+    FrameQueue::Frame frame;
+
+    while (ctx->frames.pop(frame)) {
+        // the next frame waits in the queue meanwhile, together they form the jitter buffer
+        std::this_thread::sleep_until(ctx->pacer.schedule(frame.captured));
+
+        bool handled = false;
+        while (!handled) {
+            {
+                std::lock_guard<std::mutex> lock(ctx->frameMutex);
+                MovedWindow *self = ctx->owner;
+                if (!self) {
+                    return;
+                }
+
+                void *ptr = self->pbo.getBackBuffer();
+                if (ctx->suspended) {
+                    handled = true;
+                } else if (self->pbo.hasUploadContext()) {
+                    if (self->pbo.canUpload()) {
+                        addSample(ctx->waitMillis, std::chrono::steady_clock::now() - frame.captured);
+                        // the upload thread copies the frame, so it needs its own reference to the pixels
+                        auto shot = std::make_shared<Window::Screenshot>(std::move(frame.shot));
+                        self->pbo.upload(shot->width, shot->height, shot->stride, [shot, ctx] (void *dst) {
+                            auto started = std::chrono::steady_clock::now();
+                            streamcopy::copy(dst, shot->pixels.data(), shot->pixels.size());
+                            addSample(ctx->publishMillis, std::chrono::steady_clock::now() - started);
+                        });
+                        ctx->pacer.onPresented(std::chrono::steady_clock::now());
+                        handled = true;
+                    }
+                } else if (ptr) {
+                    // frames captured before the panel was resized are dropped
+                    if (frame.shot.width == self->pbo.getBackbufferWidth() &&
+                        frame.shot.height == self->pbo.getBackbufferHeight() &&
+                        frame.shot.stride == self->pbo.getBackBufferStride())
+                    {
+                        auto started = std::chrono::steady_clock::now();
+                        addSample(ctx->waitMillis, started - frame.captured);
+                        // the mapped buffer is usually write-combined memory
+                        streamcopy::copyParallel(*self->workerPool, ptr, frame.shot.pixels.data(), frame.shot.pixels.size());
+                        self->pbo.finishBackBuffer();
+                        auto finished = std::chrono::steady_clock::now();
+                        addSample(ctx->publishMillis, finished - started);
+                        ctx->pacer.onPresented(finished);
+                    }
+                    handled = true;
+                }
+            }
+
+            if (!handled) {
+                // previous frame not drawn yet
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(1 + drawDelay * 2));
+        // return the pixels to the frame pool before waiting for the next frame
+        frame.shot.pixels.reset();
     }
 }
 
@@ -160,18 +521,25 @@ void MovedWindow::onDraw() {
     int xWinWidth = right - left;
     int xWinHeight = top - bottom;
 
+    // only read the snapshot, the window system is only queried by the capture thread
+    float ourRatio = wnd->getGeometry()->aspectRatio;
+
     bool changedGeometry = false;
     if (xWinWidth != requestedWidth) {
-        float ourRatio = wnd->getAspectRatio();
         xWinHeight = xWinWidth * ourRatio;
         bottom = top - xWinHeight;
         changedGeometry = true;
     } else if (xWinHeight != requestedHeight) {
-        float ourRatio = wnd->getAspectRatio();
         xWinWidth = xWinHeight / ourRatio;
         right = left + xWinWidth;
         changedGeometry = true;
+    } else if (std::abs(ourRatio - shownRatio) > 0.001f) {
+        // the captured region has a new aspect ratio, e.g. when cropping - keep the width
+        xWinHeight = xWinWidth * ourRatio;
+        bottom = top - xWinHeight;
+        changedGeometry = true;
     }
+    shownRatio = ourRatio;
 
     if (changedGeometry) {
         requestedHeight = top - bottom;
@@ -181,36 +549,80 @@ void MovedWindow::onDraw() {
         } else {
             XPLMSetWindowGeometry(window, left, top, right, bottom);
         }
-        pbo.setSize(requestedWidth, requestedHeight, (3 * requestedWidth + (4 - 1)) & ~(4 - 1));
+        if (autoResize) {
+            scheduleSourceResize(requestedWidth, requestedHeight, false);
+        }
+    }
+
+    // the memory budget can lower the resolution of the captures
+    float scale = resolutionScale;
+    if (changedGeometry || scale != appliedScale) {
+        appliedScale = scale;
+        int bufWidth = requestedWidth * scale;
+        int bufHeight = requestedHeight * scale;
+        pbo.setSize(bufWidth, bufHeight, (3 * bufWidth + (4 - 1)) & ~(4 - 1));
     }
 
-    XPLMBindTexture2d(textureId, 0);
     XPLMSetGraphicsState(0, 1, 0, 0, 0, 0, 0);
 
     pbo.drawFrontBuffer();
 
     glColor3f(brightness, brightness, brightness);
 
-    glBegin(GL_QUADS);
-        // map top left texture to bottom left vertex
-        glTexCoord2i(0, 1);
-        glVertex2i(left, bottom);
+    // large frames are split into tiles, draw each of them at its part of the window
+    float texWidth = pbo.getFrontbufferWidth();
+    float texHeight = pbo.getFrontbufferHeight();
+    for (auto &tile: pbo.getTiles()) {
+        int tLeft = left + (right - left) * (tile.x / texWidth);
+        int tRight = left + (right - left) * ((tile.x + tile.width) / texWidth);
+        int tTop = top - (top - bottom) * (tile.y / texHeight);
+        int tBottom = top - (top - bottom) * ((tile.y + tile.height) / texHeight);
+
+        XPLMBindTexture2d(tile.texture, 0);
+        glBegin(GL_QUADS);
+            // map top left texture to bottom left vertex
+            glTexCoord2f(tile.u0, tile.v1);
+            glVertex2i(tLeft, tBottom);
+
+            // map bottom left texture to top left vertex
+            glTexCoord2f(tile.u0, tile.v0);
+            glVertex2i(tLeft, tTop);
+
+            // map bottom right texture to top right vertex
+            glTexCoord2f(tile.u1, tile.v0);
+            glVertex2i(tRight, tTop);
+
+            // map top right texture to bottom right vertex
+            glTexCoord2f(tile.u1, tile.v1);
+            glVertex2i(tRight, tBottom);
+        glEnd();
+    }
+
+    if (showCursor) {
+        drawCursor(left, top, right, bottom);
+    }
+}
 
-        // map bottom left texture to top left vertex
-        glTexCoord2i(0, 0);
-        glVertex2i(left, top);
+void MovedWindow::drawCursor(int left, int top, int right, int bottom) {
+    if (!cursor.update()) {
+        return;
+    }
 
-        // map bottom right texture to top right vertex
-        glTexCoord2i(1, 0);
-        glVertex2i(right, top);
+    float relX, relY;
+    wnd->screenToRegion(cursor.getX(), cursor.getY(), relX, relY);
+    if (relX < 0 || relX >= 1 || relY < 0 || relY >= 1) {
+        return;
+    }
 
-        // map top right texture to bottom right vertex
-        glTexCoord2i(1, 1);
-        glVertex2i(right, bottom);
-    glEnd();
+    int x = left + relX * (right - left);
+    int y = top - relY * (top - bottom);
+    float scale = (right - left) / (float) wnd->getGeometry()->region.width;
+    cursorOverlay.draw(cursor, x, y, scale);
 }
 
 bool MovedWindow::onClick(int x, int y, XPLMMouseStatus status) {
+    lastInteraction = std::chrono::steady_clock::now();
+
     int px = 0, py = 0;
     if (!boxelToPixel(x, y, px, py)) {
         return true;
@@ -218,15 +630,15 @@ bool MovedWindow::onClick(int x, int y, XPLMMouseStatus status) {
 
     switch (status) {
     case xplm_MouseDown:
-        wnd->onMouseDown(px, py);
+        input->push(InputDispatcher::Type::DOWN, px, py);
         break;
     case xplm_MouseDrag:
         if (doDrag) {
-            wnd->onMouseDrag(px, py);
+            input->push(InputDispatcher::Type::DRAG, px, py);
         }
         break;
     case xplm_MouseUp:
-        wnd->onMouseUp(px, py);
+        input->push(InputDispatcher::Type::UP, px, py);
         break;
     }
 
@@ -245,20 +657,20 @@ XPLMCursorStatus MovedWindow::getCursor(int x, int y) {
 }
 
 bool MovedWindow::onMouseWheel(int x, int y, int wheel, int clicks) {
+    lastInteraction = std::chrono::steady_clock::now();
+
     int px = 0, py = 0;
     if (!boxelToPixel(x, y, px, py)) {
         return true;
     }
-    wnd->onWheel(px, py, clicks);
+    input->push(InputDispatcher::Type::WHEEL, px, py, clicks);
     return true;
 }
 
-void MovedWindow::correctRatio(int left, int top, int& right, int& bottom) {
+void MovedWindow::correctRatio(float ourRatio, int left, int top, int& right, int& bottom) {
     int xWinWidth = right - left;
     int xWinHeight = top - bottom;
 
-    float ourRatio = wnd->getAspectRatio();
-
     if (xWinWidth * ourRatio <= xWinHeight) {
         xWinHeight = xWinWidth * ourRatio;
     } else {
@@ -273,7 +685,8 @@ bool MovedWindow::boxelToPixel(int bx, int by, int& px, int& py) {
     int bLeft, bTop, bRight, bBottom;
     XPLMGetWindowGeometry(window, &bLeft, &bTop, &bRight, &bBottom);
 
-    correctRatio(bLeft, bTop, bRight, bBottom);
+    auto geometry = wnd->getGeometry();
+    correctRatio(geometry->aspectRatio, bLeft, bTop, bRight, bBottom);
 
     if (bLeft == bRight || bTop == bBottom) {
         px = -1;
@@ -289,22 +702,19 @@ bool MovedWindow::boxelToPixel(int bx, int by, int& px, int& py) {
     float vecX = (bx - bCenterX) / float(bRight - bLeft);
     float vecY = (by - bCenterY) / float(bTop - bBottom);
 
-    // GUI center in pixels
-    int guiWidth = wnd->getWidth();
-    int guiHeight = wnd->getHeight();
-    int pCenterX = guiWidth / 2;
-    int pCenterY = guiHeight / 2;
+    // GUI center in pixels, the panel only shows the captured region of the window
+    const Window::Region &region = geometry->region;
+    int guiWidth = region.width;
+    int guiHeight = region.height;
+    int pCenterX = region.x + guiWidth / 2;
+    int pCenterY = region.y + guiHeight / 2;
 
     // apply the vector to our center to get the coordinates in pixels
     px = pCenterX + vecX * guiWidth;
     py = pCenterY - vecY * guiHeight;
 
-    // check if it's inside the window
-    if (px >= 0 && px < guiWidth && py >= 0 && py < guiHeight) {
-        return true;
-    } else {
-        return false;
-    }
+    // check if it's inside the captured region
+    return region.contains(px, py);
 }
 
 bool MovedWindow::isInVR() const {
@@ -312,12 +722,38 @@ bool MovedWindow::isInVR() const {
 }
 
 MovedWindow::~MovedWindow() {
-    keepRunning = false;
-
-    if (captureThread) {
-        captureThread->join();
+    {
+        std::lock_guard<std::mutex> lock(capture->frameMutex);
+        capture->owner = nullptr;
     }
 
+    // the threads only hold shared state, so they can be stopped after this object is gone
+    auto ctx = capture;
+    auto dispatcher = std::move(input);
+    // the task runs on the worker, so it's alive then
+    LifecycleWorker *lifecycle = worker.get();
+    worker->post([ctx, dispatcher, lifecycle] () mutable {
+        // wakes up both stages if they are waiting for each other
+        ctx->frames.close();
+        if (ctx->publisher.joinable()) {
+            ctx->publisher.join();
+        }
+        if (ctx->thread.joinable()) {
+            if (ctx->callStarted != 0) {
+                // the capture can finish whenever the source responds again, it's joined then
+                logger::warn("Not waiting for the capture of '%s'", ctx->wnd->getTitle().c_str());
+                lifecycle->adopt(std::move(ctx->thread), [ctx] { return ctx->finished.load(); });
+            } else {
+                ctx->thread.join();
+            }
+        }
+        dispatcher.reset();
+    });
+
+    wnd->restoreGeometry();
+    wnd->setDesktopCapture(nullptr);
+    wnd->setParallelFor(nullptr);
+
     if (window) {
         XPLMDestroyWindow(window);
     }
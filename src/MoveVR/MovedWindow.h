@@ -26,51 +26,160 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include "AsyncPBO.h"
+#include "CursorOverlay.h"
+#include "InputDispatcher.h"
+#include "GLObjectPool.h"
+#include "LifecycleWorker.h"
+#include "ThreadPool.h"
+#include "UploadContext.h"
+#include "FrameQueue.h"
+#include "FramePacer.h"
 #include "DataRef.h"
 #include "src/windows/Window.h"
 
 class MovedWindow {
 public:
-    MovedWindow(std::shared_ptr<Window> window);
+    // frames are uploaded on the upload context's thread if one is given
+    MovedWindow(std::shared_ptr<Window> window, std::shared_ptr<GLObjectPool> objectPool, std::shared_ptr<LifecycleWorker> lifecycleWorker,
+            std::shared_ptr<ThreadPool> threadPool, std::shared_ptr<UploadContext> uploadContext = nullptr);
 
     void setDelay(int dly);
     void setBrightness(float bright);
     void setDoDrag(bool drag);
+    void setCropRegion(const Window::Region &region);
+    void setTrimBorders(bool trim);
+    void setAutoResize(bool resize);
+    void setDesktopCapture(std::shared_ptr<DesktopCapture> capture);
+    void setShowCursor(bool show);
+    // releases frames at a steady rate for video, at the cost of a few frames of latency
+    void setSmoothPlayback(bool smooth);
 
     int getDelay();
     float getBrightness();
     bool getDoDrag();
+    Window::Region getCropRegion();
+    bool getTrimBorders();
+    bool getAutoResize();
+    bool hasDesktopCapture();
+    bool getShowCursor();
+    bool getSmoothPlayback();
+    float getAverageInputLatency();
+    float getMaxInputLatency();
+
+    // moving averages in milliseconds: grabbing a frame, waiting for the draw callback to take it, copying it
+    struct StageTimings {
+        float capture = 0;
+        float waiting = 0;
+        float publish = 0;
+        // interval between captured frames and how much it deviates before and after pacing
+        float interval = 0;
+        float captureJitter = 0;
+        float presentJitter = 0;
+    };
+    StageTimings getStageTimings();
+
+    // true while the source window doesn't respond or its captures miss their deadline
+    bool isCaptureStalled();
 
     bool isShown();
 
+    // suspended windows are hidden and stop capturing, but keep their last frame and settings
+    void suspend();
+    void resume();
+    bool isSuspended();
+
+    struct MemoryUsage {
+        size_t gpuBytes = 0;
+        size_t hostBytes = 0;
+    };
+    MemoryUsage getMemoryUsage();
+    // frees the buffers and capture memory of a suspended window, its texture stays
+    void releaseIdleMemory();
+    // captures at a fraction of the panel size to save memory
+    void setResolutionScale(float scale);
+    float getResolutionScale();
+    std::chrono::steady_clock::time_point getLastInteraction();
+
+    // size of the panel in boxels
+    int getPanelWidth();
+    int getPanelHeight();
+    void setPanelSize(int width, int height);
+
     bool isInVR() const;
 
     ~MovedWindow();
 private:
     std::shared_ptr<Window> wnd;
+    std::shared_ptr<GLObjectPool> glPool;
+    std::shared_ptr<LifecycleWorker> worker;
+    // splits large copies and tile captures
+    std::shared_ptr<ThreadPool> workerPool;
+    std::shared_ptr<UploadContext> uploader;
     DataRef<bool> isVrEnabled;
     XPLMWindowID window = nullptr;
-    int textureId = -1;
     AsyncPBO pbo;
     std::atomic_int requestedWidth {0}, requestedHeight {0};
+    float shownRatio = 1;
+    std::atomic<float> resolutionScale { 1.0f };
+    float appliedScale = 1.0f;
+    std::chrono::steady_clock::time_point lastInteraction = std::chrono::steady_clock::now();
     std::atomic_bool doCapture;
     std::atomic_bool needRedraw;
-    std::atomic_bool keepRunning { false };
-    std::unique_ptr<std::thread> captureThread;
+    std::shared_ptr<InputDispatcher> input;
 
     std::atomic_bool doDrag { false };
     std::atomic_int drawDelay { 0 };
     std::atomic<float> brightness { 1.0f };
     int delayCount = 0;
 
-    void initTexture();
+    // the cursor is tracked and drawn every frame, independent of the captures
+    std::atomic_bool showCursor { true };
+    Cursor cursor;
+    CursorOverlay cursorOverlay;
+
+    // resizing the original window is debounced and done by the capture thread
+    std::atomic_bool autoResize { false };
+    std::atomic_bool sharedCapture { false };
+    std::mutex resizeMutex;
+    bool resizePending = false;
+    int resizeWidth = 0, resizeHeight = 0;
+    std::chrono::steady_clock::time_point resizeDue {};
+
+    // shared with the capture and publish threads, the capture thread is handed to the lifecycle worker if it's stuck in a capture during destruction
+    struct CaptureContext {
+        std::thread thread;
+        std::thread publisher;
+        // one frame of slack lets the next capture overlap the hand-off without adding much latency,
+        // with smooth playback there's a second one for the frame held back by the pacer
+        FrameQueue frames { 1 };
+        std::mutex frameMutex;
+        // reset on destruction, the capture thread only touches its MovedWindow while holding frameMutex
+        MovedWindow *owner = nullptr;
+        std::shared_ptr<Window> wnd;
+        // steady clock milliseconds when the current capture started, 0 if not capturing
+        std::atomic<int64_t> callStarted { 0 };
+        std::atomic_bool stalled { false };
+        // set when the capture thread is about to return
+        std::atomic_bool finished { false };
+        std::atomic_bool suspended { false };
+        std::atomic_bool releaseStaging { false };
+        std::atomic<float> captureMillis { 0 }, waitMillis { 0 }, publishMillis { 0 };
+        FramePacer pacer;
+    };
+    std::shared_ptr<CaptureContext> capture;
 
-    void captureLoop();
+    static void captureLoop(std::shared_ptr<CaptureContext> ctx);
+    static void publishLoop(std::shared_ptr<CaptureContext> ctx);
+    void scheduleSourceResize(int width, int height, bool restore);
+    void resizeSourceIfDue();
 
     void createWindow(const std::string &title);
     void onDraw();
-    void correctRatio(int left, int top, int &right, int &bottom);
+    void drawCursor(int left, int top, int right, int bottom);
+    void correctRatio(float ourRatio, int left, int top, int &right, int &bottom);
     bool onClick(int x, int y, XPLMMouseStatus status);
     bool onRightClick(int x, int y, XPLMMouseStatus status);
     void onKey(char key, XPLMKeyFlags flags, char virtualKey, bool losingFocus);
@@ -0,0 +1,152 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <XPLM/XPLMProcessing.h>
+#include <algorithm>
+#include "PluginProfiler.h"
+#include "src/Logger.h"
+
+namespace {
+    constexpr const size_t SAMPLE_FRAMES = 500;
+}
+
+void PluginProfiler::Samples::add(int frameCycle, float millis) {
+    if (frameCycle != cycle) {
+        if (cycle >= 0) {
+            if (frames.size() < SAMPLE_FRAMES) {
+                frames.push_back(current);
+            } else {
+                frames[next] = current;
+            }
+            next = (next + 1) % SAMPLE_FRAMES;
+        }
+        cycle = frameCycle;
+        current = 0;
+    }
+    current += millis;
+}
+
+PluginProfiler::Stats PluginProfiler::Samples::getStats() const {
+    Stats stats;
+    if (frames.empty()) {
+        return stats;
+    }
+
+    float sum = 0;
+    for (float f: frames) {
+        sum += f;
+    }
+    stats.average = sum / frames.size();
+
+    std::vector<float> sorted = frames;
+    size_t idx = (sorted.size() * 99) / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + idx, sorted.end());
+    stats.p99 = sorted[idx];
+    return stats;
+}
+
+PluginProfiler::PluginProfiler(std::shared_ptr<XPlaneWindowList> windowList):
+    windowList(windowList)
+{
+}
+
+void PluginProfiler::setEnabled(bool enable) {
+    if (enable == enabled) {
+        return;
+    }
+    enabled = enable;
+
+    if (enabled) {
+        samples.clear();
+        windowList->setCallTimer([this] (XPLMWindowID wnd, XPlaneWindowList::Callback callback, float millis) {
+            onCall(wnd, callback, millis);
+        });
+        update();
+        logger::info("Profiling plugin windows");
+    } else {
+        for (auto wnd: timedWindows) {
+            windowList->setTimed(wnd, false);
+        }
+        timedWindows.clear();
+        windowList->setCallTimer(nullptr);
+    }
+}
+
+bool PluginProfiler::isEnabled() {
+    return enabled;
+}
+
+void PluginProfiler::update() {
+    if (!enabled) {
+        return;
+    }
+
+    // restores windows that were closed, it won't touch destroyed ones
+    for (auto it = timedWindows.begin(); it != timedWindows.end();) {
+        if (!windowList->hasWindow(*it)) {
+            windowList->setTimed(*it, false);
+            it = timedWindows.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto wnd: windowList->getWindows()) {
+        if (!XPLMGetWindowIsVisible(wnd) || windowList->isTimed(wnd)) {
+            continue;
+        }
+
+        try {
+            windowList->setTimed(wnd, true);
+            timedWindows.push_back(wnd);
+        } catch (const std::exception &e) {
+            logger::verbose("Not profiling window: %s", e.what());
+        }
+    }
+}
+
+std::map<XPLMPluginID, PluginProfiler::PluginStats> PluginProfiler::getStats() {
+    std::map<XPLMPluginID, PluginStats> res;
+    for (auto &entry: samples) {
+        auto &stats = res[entry.first];
+        stats.draw = entry.second.draw.getStats();
+        stats.click = entry.second.click.getStats();
+        stats.cursor = entry.second.cursor.getStats();
+    }
+    return res;
+}
+
+void PluginProfiler::onCall(XPLMWindowID wnd, XPlaneWindowList::Callback callback, float millis) {
+    auto &plugin = samples[windowList->getPluginFromWindow(wnd)];
+    int cycle = XPLMGetCycleNumber();
+
+    switch (callback) {
+    case XPlaneWindowList::Callback::DRAW:
+        plugin.draw.add(cycle, millis);
+        break;
+    case XPlaneWindowList::Callback::CLICK:
+        plugin.click.add(cycle, millis);
+        break;
+    case XPlaneWindowList::Callback::CURSOR:
+        plugin.cursor.add(cycle, millis);
+        break;
+    }
+}
+
+PluginProfiler::~PluginProfiler() {
+    setEnabled(false);
+}
@@ -0,0 +1,80 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_PLUGINPROFILER_H_
+#define SRC_MOVEVR_PLUGINPROFILER_H_
+
+#include <XPLM/XPLMPlugin.h>
+#include <memory>
+#include <map>
+#include <vector>
+#include "src/xplane/XPlaneWindowList.h"
+
+/*
+ * Measures how much time the windows of each plugin spend in their draw, click and
+ * cursor callbacks. The callbacks of all visible windows are wrapped while profiling
+ * and restored when it is stopped. Times are summed per plugin and frame.
+ * Must only be used from the GL thread.
+ */
+class PluginProfiler {
+public:
+    struct Stats {
+        // milliseconds per frame in which the plugin's callbacks were called
+        float average = 0;
+        float p99 = 0;
+    };
+
+    struct PluginStats {
+        Stats draw, click, cursor;
+    };
+
+    PluginProfiler(std::shared_ptr<XPlaneWindowList> windowList);
+
+    void setEnabled(bool enable);
+    bool isEnabled();
+    // wraps windows that became visible since the last call
+    void update();
+
+    std::map<XPLMPluginID, PluginStats> getStats();
+
+    ~PluginProfiler();
+private:
+    // rolling window of per-frame totals
+    class Samples {
+    public:
+        void add(int cycle, float millis);
+        Stats getStats() const;
+    private:
+        std::vector<float> frames;
+        size_t next = 0;
+        int cycle = -1;
+        float current = 0;
+    };
+
+    struct PluginSamples {
+        Samples draw, click, cursor;
+    };
+
+    std::shared_ptr<XPlaneWindowList> windowList;
+    bool enabled = false;
+    std::vector<XPLMWindowID> timedWindows;
+    std::map<XPLMPluginID, PluginSamples> samples;
+
+    void onCall(XPLMWindowID wnd, XPlaneWindowList::Callback callback, float millis);
+};
+
+#endif /* SRC_MOVEVR_PLUGINPROFILER_H_ */
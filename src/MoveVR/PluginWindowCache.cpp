@@ -0,0 +1,186 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <GL/glew.h>
+#include <XPLM/XPLMGraphics.h>
+#include <XPLM/XPLMProcessing.h>
+#include <chrono>
+#include "PluginWindowCache.h"
+
+namespace {
+    constexpr const int MAX_INTERVAL = 30;
+}
+
+PluginWindowCache::PluginWindowCache(std::shared_ptr<XPlaneWindowList> windowList):
+    windowList(windowList)
+{
+}
+
+void PluginWindowCache::enable(XPLMWindowID wnd, int interval) {
+    if (interval < 1) {
+        interval = 1;
+    } else if (interval > MAX_INTERVAL) {
+        interval = MAX_INTERVAL;
+    }
+
+    auto it = entries.find(wnd);
+    if (it != entries.end()) {
+        it->second.interval = interval;
+        return;
+    }
+
+    windowList->hookDraw(wnd, [this] (XPLMWindowID id, XPLMDrawWindow_f original, void *refcon) {
+        onDraw(id, original, refcon);
+    });
+    entries[wnd].interval = interval;
+}
+
+void PluginWindowCache::disable(XPLMWindowID wnd) {
+    auto it = entries.find(wnd);
+    if (it == entries.end()) {
+        return;
+    }
+
+    windowList->unhookDraw(wnd);
+    entries.erase(it);
+}
+
+bool PluginWindowCache::isEnabled(XPLMWindowID wnd) {
+    return entries.find(wnd) != entries.end();
+}
+
+int PluginWindowCache::getInterval(XPLMWindowID wnd) {
+    auto it = entries.find(wnd);
+    if (it == entries.end()) {
+        return 1;
+    }
+    return it->second.interval;
+}
+
+float PluginWindowCache::getSavedMillis(XPLMWindowID wnd) {
+    auto it = entries.find(wnd);
+    if (it == entries.end()) {
+        return 0;
+    }
+    return it->second.savedPerFrame;
+}
+
+size_t PluginWindowCache::getMemoryUsage() {
+    size_t bytes = 0;
+    for (auto &entry: entries) {
+        bytes += entry.second.target.getMemoryUsage();
+    }
+    return bytes;
+}
+
+void PluginWindowCache::removeClosedWindows() {
+    if (entries.empty()) {
+        return;
+    }
+
+    for (auto it = entries.begin(); it != entries.end();) {
+        auto wnd = (it++)->first;
+        if (!windowList->hasWindow(wnd)) {
+            disable(wnd);
+        }
+    }
+}
+
+void PluginWindowCache::onDraw(XPLMWindowID wnd, XPLMDrawWindow_f original, void *refcon) {
+    auto it = entries.find(wnd);
+    if (it == entries.end() || it->second.target.hasFailed()) {
+        if (original) {
+            original(wnd, refcon);
+        }
+        return;
+    }
+    Entry &entry = it->second;
+
+    // both eyes are drawn in the same cycle
+    int cycle = XPLMGetCycleNumber();
+    if (cycle != entry.lastCycle) {
+        entry.lastCycle = cycle;
+        entry.framesSinceDraw++;
+        entry.savedPerFrame = entry.savedPerFrame * 0.9f + entry.savedThisFrame * 0.1f;
+        entry.savedThisFrame = 0;
+    }
+
+    int left, top, right, bottom;
+    XPLMGetWindowGeometry(wnd, &left, &top, &right, &bottom);
+    bool sizeChanged = (right - left != entry.target.getWidth() || top - bottom != entry.target.getHeight());
+
+    if (!entry.valid || sizeChanged || entry.framesSinceDraw >= entry.interval) {
+        if (!drawToTexture(entry, wnd, original, refcon)) {
+            // no framebuffer support, draw directly as if we weren't there
+            if (original) {
+                original(wnd, refcon);
+            }
+            return;
+        }
+        entry.framesSinceDraw = 0;
+    } else {
+        entry.savedThisFrame += entry.drawMillis;
+    }
+
+    entry.target.draw(left, top, right, bottom);
+}
+
+bool PluginWindowCache::drawToTexture(Entry &entry, XPLMWindowID wnd, XPLMDrawWindow_f original, void *refcon) {
+    int left, top, right, bottom;
+    XPLMGetWindowGeometry(wnd, &left, &top, &right, &bottom);
+
+    if (right - left != entry.target.getWidth() || top - bottom != entry.target.getHeight()) {
+        entry.valid = false;
+    }
+    if (!entry.target.resize(right - left, top - bottom)) {
+        return false;
+    }
+
+    entry.target.begin();
+
+    // the callback draws in window coordinates, map them onto the texture
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(left, right, bottom, top, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    auto start = std::chrono::steady_clock::now();
+    if (original) {
+        original(wnd, refcon);
+    }
+    float millis = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    entry.drawMillis = entry.valid ? entry.drawMillis * 0.9f + millis * 0.1f : millis;
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+
+    entry.target.end();
+
+    entry.valid = true;
+    return true;
+}
+
+PluginWindowCache::~PluginWindowCache() {
+    while (!entries.empty()) {
+        disable(entries.begin()->first);
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_PLUGINWINDOWCACHE_H_
+#define SRC_MOVEVR_PLUGINWINDOWCACHE_H_
+
+#include <XPLM/XPLMDisplay.h>
+#include <memory>
+#include <map>
+#include <vector>
+#include "src/xplane/XPlaneWindowList.h"
+#include "RenderTarget.h"
+
+/*
+ * Draws other plugins' windows into a texture once per frame, or once every few frames,
+ * and shows that texture instead of calling their draw callbacks again. In VR, windows
+ * are drawn once per eye, so this at least halves the cost of expensive windows.
+ * Must only be used from the GL thread.
+ */
+class PluginWindowCache {
+public:
+    PluginWindowCache(std::shared_ptr<XPlaneWindowList> windowList);
+
+    // an interval of 1 draws the window once per frame instead of once per eye
+    void enable(XPLMWindowID wnd, int interval);
+    void disable(XPLMWindowID wnd);
+    bool isEnabled(XPLMWindowID wnd);
+    int getInterval(XPLMWindowID wnd);
+    // moving average of the time saved per frame, in milliseconds
+    float getSavedMillis(XPLMWindowID wnd);
+    // forgets windows that were destroyed by their plugins
+    void removeClosedWindows();
+    // video memory of the cache textures
+    size_t getMemoryUsage();
+
+    ~PluginWindowCache();
+private:
+    struct Entry {
+        int interval = 1;
+        // the window is drawn directly if framebuffers aren't supported
+        RenderTarget target;
+        bool valid = false;
+        int lastCycle = -1;
+        int framesSinceDraw = 0;
+        // average duration of the original callback and the time saved by skipping it
+        float drawMillis = 0;
+        float savedThisFrame = 0;
+        float savedPerFrame = 0;
+    };
+
+    std::shared_ptr<XPlaneWindowList> windowList;
+    std::map<XPLMWindowID, Entry> entries;
+
+    void onDraw(XPLMWindowID wnd, XPLMDrawWindow_f original, void *refcon);
+    bool drawToTexture(Entry &entry, XPLMWindowID wnd, XPLMDrawWindow_f original, void *refcon);
+};
+
+#endif /* SRC_MOVEVR_PLUGINWINDOWCACHE_H_ */
@@ -0,0 +1,150 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <GL/glew.h>
+#include <XPLM/XPLMGraphics.h>
+#include "RenderTarget.h"
+#include "src/Logger.h"
+
+bool RenderTarget::resize(int newWidth, int newHeight) {
+    if (failed || newWidth <= 0 || newHeight <= 0) {
+        return false;
+    }
+
+    if (fbo && newWidth == width && newHeight == height) {
+        return true;
+    }
+
+    if (texture < 0) {
+        XPLMGenerateTextureNumbers(&texture, 1);
+        XPLMBindTexture2d(texture, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    XPLMBindTexture2d(texture, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, newWidth, newHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    width = newWidth;
+    height = newHeight;
+
+    if (!fbo) {
+        GLint prev = 0;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, prev);
+
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            logger::warn("Can't cache window drawing, framebuffer status %x", status);
+            release();
+            failed = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void RenderTarget::begin() {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    // the sim's scissor rect is in screen coordinates and would only let us clear part of the texture
+    scissor = glIsEnabled(GL_SCISSOR_TEST);
+    glDisable(GL_SCISSOR_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // keep the alpha channel intact so that the texture can be blended with premultiplied alpha
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void RenderTarget::end() {
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    if (scissor) {
+        glEnable(GL_SCISSOR_TEST);
+    }
+}
+
+void RenderTarget::draw(int left, int top, int right, int bottom) {
+    // 1 texture unit with alpha blending
+    XPLMSetGraphicsState(0, 1, 0, 1, 1, 0, 0);
+    XPLMBindTexture2d(texture, 0);
+
+    // the window was blended onto a transparent texture, so its colors are premultiplied
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glColor4f(1, 1, 1, 1);
+    glBegin(GL_QUADS);
+        glTexCoord2i(0, 0);
+        glVertex2i(left, bottom);
+
+        glTexCoord2i(0, 1);
+        glVertex2i(left, top);
+
+        glTexCoord2i(1, 1);
+        glVertex2i(right, top);
+
+        glTexCoord2i(1, 0);
+        glVertex2i(right, bottom);
+    glEnd();
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void RenderTarget::release() {
+    if (fbo) {
+        glDeleteFramebuffers(1, &fbo);
+        fbo = 0;
+    }
+    if (texture >= 0) {
+        GLuint tex = texture;
+        glDeleteTextures(1, &tex);
+        texture = -1;
+    }
+    width = height = 0;
+}
+
+bool RenderTarget::hasFailed() const {
+    return failed;
+}
+
+int RenderTarget::getWidth() const {
+    return width;
+}
+
+int RenderTarget::getHeight() const {
+    return height;
+}
+
+size_t RenderTarget::getMemoryUsage() const {
+    return (size_t) width * height * 4;
+}
+
+RenderTarget::~RenderTarget() {
+    release();
+}
@@ -0,0 +1,61 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_RENDERTARGET_H_
+#define SRC_MOVEVR_RENDERTARGET_H_
+
+#include <cstddef>
+
+/*
+ * A texture with a framebuffer for caching the drawing of a window. Everything that is
+ * rendered between begin() and end() is blended onto a transparent texture, so draw()
+ * shows it with premultiplied alpha. All functions must be called from the GL thread.
+ */
+class RenderTarget {
+public:
+    RenderTarget() = default;
+    RenderTarget(const RenderTarget &other) = delete;
+    RenderTarget &operator=(const RenderTarget &other) = delete;
+
+    // false if framebuffers aren't supported, the window has to be drawn directly then
+    bool resize(int width, int height);
+    // binds and clears the framebuffer, the previous framebuffer and state are restored by end()
+    void begin();
+    void end();
+    void draw(int left, int top, int right, int bottom);
+    void release();
+
+    bool hasFailed() const;
+    int getWidth() const;
+    int getHeight() const;
+    size_t getMemoryUsage() const;
+
+    ~RenderTarget();
+private:
+    unsigned int fbo = 0;
+    int texture = -1;
+    int width = 0, height = 0;
+    bool failed = false;
+
+    // state of the sim's framebuffer while we're rendering into ours
+    int prevFbo = 0;
+    int viewport[4] {};
+    float clearColor[4] {};
+    bool scissor = false;
+};
+
+#endif /* SRC_MOVEVR_RENDERTARGET_H_ */
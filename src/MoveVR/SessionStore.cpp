@@ -0,0 +1,175 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <fstream>
+#include <sstream>
+#include "SessionStore.h"
+#include "src/Logger.h"
+
+namespace {
+    // one window per line, fields separated by tabs
+    constexpr const char *HEADER = "MoveVR session 1";
+
+    std::string sanitize(const std::string &str) {
+        std::string res = str;
+        for (char &c: res) {
+            if (c == '\t' || c == '\n' || c == '\r') {
+                c = ' ';
+            }
+        }
+        return res;
+    }
+}
+
+SessionStore::SessionStore(const std::string &path):
+    filePath(path)
+{
+}
+
+SessionStore::Session SessionStore::load() const {
+    Session session;
+
+    std::ifstream file(filePath);
+    if (!file) {
+        return session;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line != HEADER) {
+        logger::warn("Ignoring session file with unknown format: %s", filePath.c_str());
+        return session;
+    }
+
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields;
+        std::istringstream lineStream(line);
+        std::string field;
+        while (std::getline(lineStream, field, '\t')) {
+            fields.push_back(field);
+        }
+
+        if (fields.size() == 2 && fields[0] == "releaseOnSuspend") {
+            session.releaseOnSuspend = (fields[1] == "1");
+            continue;
+        }
+
+        if (fields.size() == 2 && fields[0] == "largePages") {
+            session.largePages = (fields[1] == "1");
+            continue;
+        }
+
+        if (fields.size() == 2 && fields[0] == "sharedUpload") {
+            session.sharedUpload = (fields[1] == "1");
+            continue;
+        }
+
+        if (fields.size() == 2 && fields[0] == "memoryBudget") {
+            try {
+                session.memoryBudgetMB = std::stoi(fields[1]);
+            } catch (const std::exception &e) {
+                logger::warn("Ignoring invalid memory budget: %s", e.what());
+            }
+            continue;
+        }
+
+        // older sessions don't have the last field
+        if ((fields.size() != 16 && fields.size() != 17) || fields[0] != "window") {
+            continue;
+        }
+
+        try {
+            WindowState state;
+            state.processName = fields[1];
+            state.title = fields[2];
+            state.panelWidth = std::stoi(fields[3]);
+            state.panelHeight = std::stoi(fields[4]);
+            state.delay = std::stoi(fields[5]);
+            state.brightness = std::stof(fields[6]);
+            state.dragging = (fields[7] == "1");
+            state.crop.x = std::stoi(fields[8]);
+            state.crop.y = std::stoi(fields[9]);
+            state.crop.width = std::stoi(fields[10]);
+            state.crop.height = std::stoi(fields[11]);
+            state.trimBorders = (fields[12] == "1");
+            state.autoResize = (fields[13] == "1");
+            state.sharedCapture = (fields[14] == "1");
+            state.showCursor = (fields[15] == "1");
+            state.smoothPlayback = (fields.size() > 16 && fields[16] == "1");
+            session.windows.push_back(state);
+        } catch (const std::exception &e) {
+            logger::warn("Ignoring invalid session entry: %s", e.what());
+        }
+    }
+
+    logger::verbose("Loaded %d windows from session", (int) session.windows.size());
+    return session;
+}
+
+void SessionStore::save(const Session &session) const {
+    std::ofstream file(filePath);
+    if (!file) {
+        logger::warn("Couldn't write session file %s", filePath.c_str());
+        return;
+    }
+
+    file << HEADER << "\n";
+    file << "releaseOnSuspend\t" << (session.releaseOnSuspend ? 1 : 0) << "\n";
+    file << "memoryBudget\t" << session.memoryBudgetMB << "\n";
+    file << "largePages\t" << (session.largePages ? 1 : 0) << "\n";
+    file << "sharedUpload\t" << (session.sharedUpload ? 1 : 0) << "\n";
+
+    for (auto &state: session.windows) {
+        file << "window"
+             << "\t" << sanitize(state.processName)
+             << "\t" << sanitize(state.title)
+             << "\t" << state.panelWidth << "\t" << state.panelHeight
+             << "\t" << state.delay << "\t" << state.brightness
+             << "\t" << (state.dragging ? 1 : 0)
+             << "\t" << state.crop.x << "\t" << state.crop.y << "\t" << state.crop.width << "\t" << state.crop.height
+             << "\t" << (state.trimBorders ? 1 : 0)
+             << "\t" << (state.autoResize ? 1 : 0)
+             << "\t" << (state.sharedCapture ? 1 : 0)
+             << "\t" << (state.showCursor ? 1 : 0)
+             << "\t" << (state.smoothPlayback ? 1 : 0)
+             << "\n";
+    }
+}
+
+int SessionStore::findMatch(const WindowState &state, const std::vector<std::shared_ptr<Window>> &windows) {
+    // prefer an exact match, but titles often change, e.g. with the open document
+    int sameProcess = -1;
+    int sameProcessCount = 0;
+
+    for (size_t i = 0; i < windows.size(); i++) {
+        auto meta = windows[i]->getMetadata();
+        if (meta->processName != state.processName) {
+            continue;
+        }
+
+        if (meta->title == state.title) {
+            return i;
+        }
+
+        sameProcess = i;
+        sameProcessCount++;
+    }
+
+    if (sameProcessCount == 1 && !state.processName.empty()) {
+        return sameProcess;
+    }
+    return -1;
+}
@@ -0,0 +1,65 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_SESSIONSTORE_H_
+#define SRC_MOVEVR_SESSIONSTORE_H_
+
+#include <string>
+#include <vector>
+#include "src/windows/Window.h"
+
+/*
+ * Persists the VR windows and their settings so that they can be restored after a restart.
+ * Windows get new handles on every start, so they are matched by process name and title.
+ */
+class SessionStore {
+public:
+    struct WindowState {
+        std::string processName;
+        std::string title;
+        int panelWidth = 0, panelHeight = 0;
+        int delay = 0;
+        float brightness = 1;
+        bool dragging = false;
+        Window::Region crop {};
+        bool trimBorders = false;
+        bool autoResize = false;
+        bool sharedCapture = false;
+        bool showCursor = true;
+        bool smoothPlayback = false;
+    };
+
+    struct Session {
+        bool releaseOnSuspend = false;
+        int memoryBudgetMB = 512;
+        // needs the privilege to lock pages in memory, so there's no UI for it
+        bool largePages = false;
+        bool sharedUpload = false;
+        std::vector<WindowState> windows;
+    };
+
+    SessionStore(const std::string &path);
+    Session load() const;
+    void save(const Session &session) const;
+
+    // index of the window that best matches the state, -1 if none
+    static int findMatch(const WindowState &state, const std::vector<std::shared_ptr<Window>> &windows);
+private:
+    std::string filePath;
+};
+
+#endif /* SRC_MOVEVR_SESSIONSTORE_H_ */
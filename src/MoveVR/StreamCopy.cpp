@@ -0,0 +1,131 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <emmintrin.h>
+#include <cstdint>
+#include <cstring>
+#include "StreamCopy.h"
+
+namespace {
+    // below this, splitting the copy costs more than it saves
+    constexpr const size_t MIN_PARALLEL_PART = 1024 * 1024;
+
+    void streamBlock(uint8_t *dst, const uint8_t *src, size_t bytes) {
+        // dst is 16 byte aligned here, the source might not be
+        __m128i *out = reinterpret_cast<__m128i *>(dst);
+        size_t blocks = bytes / 64;
+
+        if ((reinterpret_cast<uintptr_t>(src) & 15) == 0) {
+            const __m128i *in = reinterpret_cast<const __m128i *>(src);
+            for (size_t i = 0; i < blocks; i++) {
+                __m128i a = _mm_load_si128(in + 0);
+                __m128i b = _mm_load_si128(in + 1);
+                __m128i c = _mm_load_si128(in + 2);
+                __m128i d = _mm_load_si128(in + 3);
+                _mm_stream_si128(out + 0, a);
+                _mm_stream_si128(out + 1, b);
+                _mm_stream_si128(out + 2, c);
+                _mm_stream_si128(out + 3, d);
+                in += 4;
+                out += 4;
+            }
+        } else {
+            const __m128i *in = reinterpret_cast<const __m128i *>(src);
+            for (size_t i = 0; i < blocks; i++) {
+                __m128i a = _mm_loadu_si128(in + 0);
+                __m128i b = _mm_loadu_si128(in + 1);
+                __m128i c = _mm_loadu_si128(in + 2);
+                __m128i d = _mm_loadu_si128(in + 3);
+                _mm_stream_si128(out + 0, a);
+                _mm_stream_si128(out + 1, b);
+                _mm_stream_si128(out + 2, c);
+                _mm_stream_si128(out + 3, d);
+                in += 4;
+                out += 4;
+            }
+        }
+    }
+
+    void copyUnfenced(uint8_t *dst, const uint8_t *src, size_t bytes) {
+        // plain stores until the destination is aligned, they only write as well
+        size_t head = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15;
+        if (head > bytes) {
+            head = bytes;
+        }
+        memcpy(dst, src, head);
+        dst += head;
+        src += head;
+        bytes -= head;
+
+        size_t body = bytes & ~(size_t) 63;
+        streamBlock(dst, src, body);
+
+        memcpy(dst + body, src + body, bytes - body);
+    }
+}
+
+namespace streamcopy {
+
+void copy(void *dst, const void *src, size_t bytes) {
+    copyUnfenced(static_cast<uint8_t *>(dst), static_cast<const uint8_t *>(src), bytes);
+    // make the streamed data visible before the buffer is handed to GL
+    _mm_sfence();
+}
+
+void copyRows(void *dst, size_t dstStride, const void *src, size_t srcStride, size_t rowBytes, size_t rows) {
+    if (dstStride == srcStride && rowBytes == srcStride) {
+        copy(dst, src, rowBytes * rows);
+        return;
+    }
+
+    uint8_t *out = static_cast<uint8_t *>(dst);
+    const uint8_t *in = static_cast<const uint8_t *>(src);
+    for (size_t y = 0; y < rows; y++) {
+        copyUnfenced(out + y * dstStride, in + y * srcStride, rowBytes);
+    }
+    _mm_sfence();
+}
+
+void copyParallel(ThreadPool &pool, void *dst, const void *src, size_t bytes) {
+    // the calling thread also copies, so one part more than the pool's threads
+    size_t parts = bytes / MIN_PARALLEL_PART;
+    if (parts > pool.getThreadCount() + 1) {
+        parts = pool.getThreadCount() + 1;
+    }
+
+    if (parts <= 1) {
+        copy(dst, src, bytes);
+        return;
+    }
+
+    // split at cache line boundaries so that no two threads write the same line
+    size_t partSize = (bytes / parts + 63) & ~(size_t) 63;
+    uint8_t *out = static_cast<uint8_t *>(dst);
+    const uint8_t *in = static_cast<const uint8_t *>(src);
+
+    pool.parallelFor(parts, [out, in, bytes, partSize] (size_t part) {
+        size_t offset = part * partSize;
+        if (offset >= bytes) {
+            return;
+        }
+        size_t len = (offset + partSize <= bytes) ? partSize : bytes - offset;
+        // each thread has its own write-combining buffers to flush
+        copy(out + offset, in + offset, len);
+    });
+}
+
+}
@@ -0,0 +1,41 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_STREAMCOPY_H_
+#define SRC_MOVEVR_STREAMCOPY_H_
+
+#include <cstddef>
+#include "ThreadPool.h"
+
+/*
+ * Copies into memory that is mapped write-combined, e.g. pixel buffer objects.
+ * Uses non-temporal stores and never reads from the destination, reading
+ * write-combined memory is extremely slow.
+ */
+namespace streamcopy {
+
+void copy(void *dst, const void *src, size_t bytes);
+
+// copies rows with different strides, e.g. to add or remove row padding
+void copyRows(void *dst, size_t dstStride, const void *src, size_t srcStride, size_t rowBytes, size_t rows);
+
+// large copies are split across the pool's threads
+void copyParallel(ThreadPool &pool, void *dst, const void *src, size_t bytes);
+
+}
+
+#endif /* SRC_MOVEVR_STREAMCOPY_H_ */
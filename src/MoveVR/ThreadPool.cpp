@@ -0,0 +1,118 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t numThreads):
+    threadCount(numThreads)
+{
+    for (size_t i = 0; i < numThreads; i++) {
+        threads.emplace_back(&ThreadPool::workLoop, this);
+    }
+}
+
+size_t ThreadPool::getThreadCount() const {
+    return threadCount;
+}
+
+void ThreadPool::parallelFor(size_t parts, const Job &job) {
+    if (parts == 0) {
+        return;
+    }
+
+    std::shared_ptr<Batch> batch;
+    if (parts > 1 && threadCount > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (keepRunning) {
+            batch = std::make_shared<Batch>();
+            batch->job = job;
+            batch->parts = parts;
+            batches.push_back(batch);
+        }
+    }
+
+    if (!batch) {
+        for (size_t i = 0; i < parts; i++) {
+            job(i);
+        }
+        return;
+    }
+    condition.notify_all();
+
+    work(*batch);
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->finished.wait(lock, [&batch] { return batch->done == batch->parts; });
+}
+
+void ThreadPool::work(Batch &batch) {
+    while (true) {
+        size_t part = batch.next++;
+        if (part >= batch.parts) {
+            break;
+        }
+
+        batch.job(part);
+
+        if (++batch.done == batch.parts) {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            batch.finished.notify_all();
+        }
+    }
+}
+
+void ThreadPool::workLoop() {
+    while (true) {
+        std::shared_ptr<Batch> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return !keepRunning || !batches.empty(); });
+            if (!keepRunning) {
+                break;
+            }
+
+            batch = batches.front();
+        }
+
+        work(*batch);
+
+        // all parts are handed out now, so the next batch can be worked on
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!batches.empty() && batches.front() == batch) {
+            batches.pop_front();
+        }
+    }
+}
+
+void ThreadPool::shutdown() {
+    std::vector<std::thread> stopped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        keepRunning = false;
+        stopped.swap(threads);
+    }
+    condition.notify_all();
+
+    // batches that are still queued are finished by their callers
+    for (auto &thread: stopped) {
+        thread.join();
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    shutdown();
+}
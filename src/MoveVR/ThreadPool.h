@@ -0,0 +1,69 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_THREADPOOL_H_
+#define SRC_MOVEVR_THREADPOOL_H_
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+
+/*
+ * A fixed set of worker threads for splitting a job into parts. Several threads can
+ * use the pool at the same time, the calling thread always helps with its own job.
+ */
+class ThreadPool {
+public:
+    using Job = std::function<void(size_t part)>;
+
+    explicit ThreadPool(size_t numThreads);
+
+    // runs job(0) to job(parts - 1) and returns when all of them are done
+    void parallelFor(size_t parts, const Job &job);
+    size_t getThreadCount() const;
+    // joins the threads, jobs are run by the calling thread afterwards
+    void shutdown();
+
+    ~ThreadPool();
+private:
+    struct Batch {
+        Job job;
+        size_t parts = 0;
+        std::atomic_size_t next { 0 };
+        std::atomic_size_t done { 0 };
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::shared_ptr<Batch>> batches;
+    bool keepRunning = true;
+    const size_t threadCount;
+    std::vector<std::thread> threads;
+
+    void workLoop();
+    static void work(Batch &batch);
+};
+
+#endif /* SRC_MOVEVR_THREADPOOL_H_ */
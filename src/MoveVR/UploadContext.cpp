@@ -0,0 +1,89 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <GL/glew.h>
+#include <stdexcept>
+#include "UploadContext.h"
+#include "src/Logger.h"
+
+UploadContext::UploadContext() {
+    HGLRC simContext = wglGetCurrentContext();
+    dc = wglGetCurrentDC();
+    if (!simContext || !dc) {
+        throw std::runtime_error("No current GL context");
+    }
+
+    // created on the simulator's device context so that the pixel formats match
+    context = wglCreateContext(dc);
+    if (!context) {
+        throw std::runtime_error("Couldn't create upload context");
+    }
+
+    if (!wglShareLists(simContext, context)) {
+        wglDeleteContext(context);
+        throw std::runtime_error("Couldn't share objects with the simulator's context");
+    }
+
+    thread = std::make_unique<std::thread>(&UploadContext::workLoop, this);
+}
+
+void UploadContext::post(Task task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(std::move(task));
+    condition.notify_one();
+}
+
+void UploadContext::workLoop() {
+    if (!wglMakeCurrent(dc, context)) {
+        logger::warn("Couldn't activate the upload context");
+    }
+
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return !keepRunning || !queue.empty(); });
+            // pending tasks are still run on shutdown, they free the GL objects of closed windows
+            if (queue.empty()) {
+                break;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        try {
+            task();
+        } catch (const std::exception &e) {
+            logger::warn("Upload task failed: %s", e.what());
+        }
+    }
+
+    glFinish();
+    wglMakeCurrent(nullptr, nullptr);
+}
+
+UploadContext::~UploadContext() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        keepRunning = false;
+        condition.notify_one();
+    }
+    if (thread) {
+        thread->join();
+    }
+    wglDeleteContext(context);
+}
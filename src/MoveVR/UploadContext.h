@@ -0,0 +1,54 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_MOVEVR_UPLOADCONTEXT_H_
+#define SRC_MOVEVR_UPLOADCONTEXT_H_
+
+#include <windows.h>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+/*
+ * A GL context that shares its objects with the simulator's context and is current
+ * on its own thread, so that textures can be uploaded outside of the draw callbacks.
+ * Must be created on the simulator's GL thread. Tasks run in the order they were
+ * posted and must not call any XPLM functions.
+ */
+class UploadContext {
+public:
+    using Task = std::function<void()>;
+
+    UploadContext();
+    void post(Task task);
+    ~UploadContext();
+private:
+    HDC dc {};
+    HGLRC context {};
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Task> queue;
+    bool keepRunning = true;
+    std::unique_ptr<std::thread> thread;
+
+    void workLoop();
+};
+
+#endif /* SRC_MOVEVR_UPLOADCONTEXT_H_ */
@@ -15,26 +15,62 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <unordered_set>
 #include <algorithm>
+#include <chrono>
+#include <thread>
+#include <XPLM/XPLMGraphics.h>
 #include "WindowManager.h"
+#include "src/windows/FramePool.h"
 #include "src/Logger.h"
 
-WindowManager::WindowManager() {
+namespace {
+    // how long unloading waits for captures that are stuck in hung applications
+    constexpr const std::chrono::milliseconds SHUTDOWN_TIMEOUT(3000);
+    // large copies into mapped buffers are split across these, the sim needs the other cores
+    constexpr const size_t MAX_WORKER_THREADS = 3;
+
+    float millisSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+WindowManager::WindowManager(const std::string &sessionPath):
+    sessionStore(sessionPath)
+{
+    auto session = sessionStore.load();
+    for (auto &state: session.windows) {
+        pendingWindows.push_back(PendingWindow {state, nullptr});
+    }
+    releaseOnSuspend = session.releaseOnSuspend;
+    memoryBudget = std::make_shared<MemoryBudget>();
+    memoryBudget->setBudget(session.memoryBudgetMB * 1024 * 1024);
+    largePages = session.largePages;
+    FramePool::shared().setUseLargePages(largePages);
+    sharedUpload = session.sharedUpload;
+
     xplaneWindows = std::make_shared<XPlaneWindowList>();
+    pluginWindowCache = std::make_shared<PluginWindowCache>(xplaneWindows);
+    pluginProfiler = std::make_shared<PluginProfiler>(xplaneWindows);
+    desktopCapture = std::make_shared<DesktopCapture>();
+    glPool = std::make_shared<GLObjectPool>([] (unsigned int tex) {
+        XPLMBindTexture2d(tex, 0);
+    });
+    lifecycleWorker = std::make_shared<LifecycleWorker>();
+
+    size_t cores = std::thread::hardware_concurrency();
+    workerPool = std::make_shared<ThreadPool>(std::min(cores > 2 ? cores / 2 - 1 : 0, MAX_WORKER_THREADS));
 
     vrCapturer.setTriggerCallback([this] (XPLMMouseStatus status, float px, float py) {
-        if (px > 0 && py > 0) {
-            // only forward panel clicks to not mess up plugin windows
-            auto allWindows = xplaneWindows->findWindows();
-            for (auto wnd: triggerReceivers) {
-                if (std::find(allWindows.begin(), allWindows.end(), wnd) != allWindows.end()) {
-                    xplaneWindows->sendLeftClick(wnd, status, -1, -1);
-                }
-            }
-        }
+        onPanelTrigger(status, px, py);
     });
 }
 
+void WindowManager::warmUp() {
+    // enough for two windows that don't need tiling
+    glPool->warmUp(4, 2);
+}
+
 void WindowManager::addTriggerReceiver(XPLMWindowID wnd) {
     triggerReceivers.insert(wnd);
     if (isInVR) {
@@ -44,6 +80,10 @@ void WindowManager::addTriggerReceiver(XPLMWindowID wnd) {
 
 void WindowManager::removeTriggerReceiver(XPLMWindowID wnd) {
     triggerReceivers.erase(wnd);
+    panelRegions.remove(wnd);
+    if (activeReceiver == wnd) {
+        activeReceiver = {};
+    }
     if (isInVR) {
         if (triggerReceivers.empty()) {
             vrCapturer.setEnabled(false);
@@ -55,51 +95,119 @@ bool WindowManager::isTriggerReceiver(XPLMWindowID wnd) {
     return triggerReceivers.find(wnd) != triggerReceivers.end();
 }
 
+void WindowManager::setTriggerRegion(XPLMWindowID wnd, const PanelRegions::Region &region) {
+    if (isTriggerReceiver(wnd)) {
+        panelRegions.set(wnd, region);
+    }
+}
+
+PanelRegions::Region WindowManager::getTriggerRegion(XPLMWindowID wnd) {
+    return panelRegions.get(wnd);
+}
+
+void WindowManager::onPanelTrigger(XPLMMouseStatus status, float px, float py) {
+    // called every frame while the trigger is held, so only use the cached list and the index
+    bool onPanel = px > 0 && py > 0;
+
+    if (status == xplm_MouseDown) {
+        activeReceiver = onPanel ? panelRegions.find(px, py) : XPLMWindowID {};
+        if (activeReceiver && !xplaneWindows->hasWindow(activeReceiver)) {
+            activeReceiver = {};
+        }
+    }
+
+    if (activeReceiver) {
+        // drags and the release go to the window that got the press, even outside of its region
+        float relX, relY;
+        panelRegions.toRegion(activeReceiver, px, py, relX, relY);
+        int left, top, right, bottom;
+        XPLMGetWindowGeometry(activeReceiver, &left, &top, &right, &bottom);
+        int x = left + relX * (right - left);
+        int y = bottom + relY * (top - bottom);
+        if (xplaneWindows->hasWindow(activeReceiver)) {
+            xplaneWindows->sendLeftClick(activeReceiver, status, x, y);
+        }
+        if (status == xplm_MouseUp) {
+            activeReceiver = {};
+        }
+        return;
+    }
+
+    if (!onPanel) {
+        // only forward panel clicks to not mess up plugin windows
+        return;
+    }
+
+    // receivers without a region get all other panel clicks, without coordinates
+    for (auto wnd: triggerReceivers) {
+        if (!panelRegions.has(wnd) && xplaneWindows->hasWindow(wnd)) {
+            xplaneWindows->sendLeftClick(wnd, status, -1, -1);
+        }
+    }
+}
+
 void WindowManager::onVRStateChanged(bool inVr) {
     isInVR = inVr;
     if (isInVR) {
+        // the receivers were kept while we were out of VR, their plugins might have closed them since
+        for (auto it = triggerReceivers.begin(); it != triggerReceivers.end(); ) {
+            if (xplaneWindows->hasWindow(*it)) {
+                ++it;
+            } else {
+                panelRegions.remove(*it);
+                it = triggerReceivers.erase(it);
+            }
+        }
         if (!triggerReceivers.empty()) {
             vrCapturer.setEnabled(true);
         }
+        resumeWindows();
     } else {
-        closeVRWindows();
+        suspendVRWindows();
         vrCapturer.setEnabled(false);
     }
 }
 
+void WindowManager::onPlaneReload() {
+    suspendVRWindows();
+    // resumed by the next update so that the reload is complete
+    resumeAfterReload = true;
+}
+
 void WindowManager::update() {
-    auto currentWindows = findWindows();
-
-    // Remove non-existing
-    for (auto it = systemWindows.begin(); it != systemWindows.end(); ) {
-        bool exists = false;
-        for (auto &curWin: currentWindows) {
-            if ((*it)->isEqual(*curWin)) {
-                exists = true;
-                break;
-            }
+    if (resumeAfterReload) {
+        resumeAfterReload = false;
+        if (isInVR) {
+            resumeWindows();
         }
+    }
 
-        if (!exists) {
-            movedWindows.erase(*it);
-            it = systemWindows.erase(it);
+    // the discovery service keeps the Window instances stable, so identity is enough to diff
+    auto snapshot = windowDiscovery.getSnapshot();
+    if (snapshot->generation == knownGeneration) {
+        return;
+    }
+    knownGeneration = snapshot->generation;
+
+    std::unordered_set<const Window *> current;
+    current.reserve(snapshot->windows.size());
+    for (auto &win: snapshot->windows) {
+        current.insert(win.get());
+    }
+
+    for (auto it = movedWindows.begin(); it != movedWindows.end(); ) {
+        if (current.find(it->first.get()) == current.end()) {
+            it = movedWindows.erase(it);
         } else {
             ++it;
         }
     }
 
-    // Add new ones
-    for (auto &win: currentWindows) {
-        bool exists = false;
-        for (auto &sysWin: systemWindows) {
-            if (sysWin->isEqual(*win)) {
-                exists = true;
-                break;
-            }
-        }
-        if (!exists) {
-            systemWindows.push_back(win);
-        }
+    systemWindows = snapshot->windows;
+
+    // windows from the session file show up once they were discovered
+    if (isInVR && !pendingWindows.empty()) {
+        restorePendingWindows();
     }
 }
 
@@ -113,9 +221,35 @@ std::shared_ptr<XPlaneWindowList> WindowManager::getXPlaneWindows() {
     return xplaneWindows;
 }
 
+std::shared_ptr<DesktopCapture> WindowManager::getDesktopCapture() {
+    return desktopCapture;
+}
+
+std::shared_ptr<MemoryBudget> WindowManager::getMemoryBudget() {
+    return memoryBudget;
+}
+
+std::shared_ptr<PluginWindowCache> WindowManager::getPluginWindowCache() {
+    return pluginWindowCache;
+}
+
+std::shared_ptr<PluginProfiler> WindowManager::getPluginProfiler() {
+    return pluginProfiler;
+}
+
 std::shared_ptr<MovedWindow> WindowManager::moveToVR(std::shared_ptr<Window> window) {
-    auto movedWnd = std::make_shared<MovedWindow>(window);
+    auto start = std::chrono::steady_clock::now();
+    if (sharedUpload && !uploadContext) {
+        try {
+            uploadContext = std::make_shared<UploadContext>();
+        } catch (const std::exception &e) {
+            logger::warn("Uploading in the draw callback: %s", e.what());
+            sharedUpload = false;
+        }
+    }
+    auto movedWnd = std::make_shared<MovedWindow>(window, glPool, lifecycleWorker, workerPool, sharedUpload ? uploadContext : nullptr);
     movedWindows.insert(std::make_pair(window, movedWnd));
+    logger::verbose("Moving '%s' took %.2f ms", window->getTitle().c_str(), millisSince(start));
     return movedWnd;
 }
 
@@ -127,23 +261,163 @@ std::shared_ptr<MovedWindow> WindowManager::findMovedWindow(std::shared_ptr<Wind
     return it->second;
 }
 
-void WindowManager::checkForClose() {
+void WindowManager::checkForClose(size_t uiBytes) {
     for (auto it = movedWindows.begin(); it != movedWindows.end(); ) {
-        if (!it->second->isShown()) {
+        if (!it->second->isShown() && !it->second->isSuspended()) {
+            auto start = std::chrono::steady_clock::now();
             it = movedWindows.erase(it);
+            logger::verbose("Closing window took %.2f ms", millisSince(start));
         } else {
             ++it;
         }
     }
+
+    glPool->trim();
+    pluginWindowCache->removeClosedWindows();
+    pluginProfiler->update();
+
+    std::vector<std::shared_ptr<MovedWindow>> windows;
+    windows.reserve(movedWindows.size());
+    for (auto &entry: movedWindows) {
+        windows.push_back(entry.second);
+    }
+    size_t sharedBytes = desktopCapture->getMemoryUsage() + FramePool::shared().getPooledBytes();
+    sharedBytes += pluginWindowCache->getMemoryUsage() + uiBytes;
+    memoryBudget->enforce(windows, sharedBytes);
 }
 
-void WindowManager::closeVRWindows() {
-    triggerReceivers.clear();
+void WindowManager::suspendVRWindows() {
+    auto start = std::chrono::steady_clock::now();
+
+    // the trigger receivers and their regions are kept for the next time we're in VR
+    activeReceiver = {};
     for (auto it = movedWindows.begin(); it != movedWindows.end(); ) {
-        if (it->second->isInVR()) {
+        if (!it->second->isInVR()) {
+            ++it;
+            continue;
+        }
+
+        if (releaseOnSuspend) {
+            // frees the textures, the window is moved again from its saved state
+            pendingWindows.push_back(PendingWindow {getState(it->first, it->second), it->first});
             it = movedWindows.erase(it);
         } else {
+            it->second->suspend();
             ++it;
         }
     }
+
+    saveSession();
+    logger::verbose("Suspending VR windows took %.2f ms", millisSince(start));
+}
+
+void WindowManager::resumeWindows() {
+    for (auto &entry: movedWindows) {
+        entry.second->resume();
+    }
+    restorePendingWindows();
+}
+
+void WindowManager::restorePendingWindows() {
+    for (auto it = pendingWindows.begin(); it != pendingWindows.end(); ) {
+        std::shared_ptr<Window> window = it->window;
+        if (window) {
+            // released in this session: the discovery keeps the instance while the window exists
+            if (std::find(systemWindows.begin(), systemWindows.end(), window) == systemWindows.end()) {
+                it = pendingWindows.erase(it);
+                continue;
+            }
+        } else {
+            int idx = SessionStore::findMatch(it->state, systemWindows);
+            if (idx >= 0) {
+                window = systemWindows[idx];
+            }
+        }
+
+        if (!window || findMovedWindow(window)) {
+            ++it;
+            continue;
+        }
+
+        auto moved = moveToVR(window);
+        applyState(moved, it->state);
+        it = pendingWindows.erase(it);
+    }
+}
+
+void WindowManager::setReleaseOnSuspend(bool release) {
+    releaseOnSuspend = release;
+}
+
+bool WindowManager::getReleaseOnSuspend() {
+    return releaseOnSuspend;
+}
+
+void WindowManager::setSharedUpload(bool enable) {
+    sharedUpload = enable;
+}
+
+bool WindowManager::getSharedUpload() {
+    return sharedUpload;
+}
+
+SessionStore::WindowState WindowManager::getState(std::shared_ptr<Window> window, std::shared_ptr<MovedWindow> moved) {
+    auto meta = window->getMetadata();
+
+    SessionStore::WindowState state;
+    state.processName = meta->processName;
+    state.title = meta->title;
+    state.panelWidth = moved->getPanelWidth();
+    state.panelHeight = moved->getPanelHeight();
+    state.delay = moved->getDelay();
+    state.brightness = moved->getBrightness();
+    state.dragging = moved->getDoDrag();
+    state.crop = moved->getCropRegion();
+    state.trimBorders = moved->getTrimBorders();
+    state.autoResize = moved->getAutoResize();
+    state.sharedCapture = moved->hasDesktopCapture();
+    state.showCursor = moved->getShowCursor();
+    state.smoothPlayback = moved->getSmoothPlayback();
+    return state;
+}
+
+void WindowManager::applyState(std::shared_ptr<MovedWindow> moved, const SessionStore::WindowState &state) {
+    moved->setDelay(state.delay);
+    moved->setBrightness(state.brightness);
+    moved->setDoDrag(state.dragging);
+    moved->setCropRegion(state.crop);
+    moved->setTrimBorders(state.trimBorders);
+    moved->setAutoResize(state.autoResize);
+    moved->setDesktopCapture(state.sharedCapture ? desktopCapture : nullptr);
+    moved->setShowCursor(state.showCursor);
+    moved->setSmoothPlayback(state.smoothPlayback);
+    moved->setPanelSize(state.panelWidth, state.panelHeight);
+}
+
+bool WindowManager::shutdown() {
+    // the windows hand their threads to the lifecycle worker
+    movedWindows.clear();
+    bool stopped = lifecycleWorker->shutdown(SHUTDOWN_TIMEOUT);
+    // must not be left to static destruction, joining threads under the loader lock deadlocks
+    workerPool->shutdown();
+    return stopped;
+}
+
+void WindowManager::saveSession() {
+    SessionStore::Session session;
+    session.releaseOnSuspend = releaseOnSuspend;
+    session.memoryBudgetMB = memoryBudget->getBudget() / (1024 * 1024);
+    session.largePages = largePages;
+    session.sharedUpload = sharedUpload;
+    for (auto &pending: pendingWindows) {
+        session.windows.push_back(pending.state);
+    }
+
+    for (auto &entry: movedWindows) {
+        if (entry.second->isInVR() || entry.second->isSuspended()) {
+            session.windows.push_back(getState(entry.first, entry.second));
+        }
+    }
+
+    sessionStore.save(session);
 }
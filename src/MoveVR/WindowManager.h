@@ -24,39 +24,102 @@
 #include <set>
 #include <functional>
 #include "src/windows/Window.h"
+#include "src/windows/DesktopCapture.h"
+#include "src/windows/WindowDiscovery.h"
 #include "src/xplane/XPlaneWindowList.h"
 #include "src/xplane/VRTriggerCapturer.h"
+#include "src/xplane/PanelRegions.h"
 #include "MovedWindow.h"
+#include "GLObjectPool.h"
+#include "LifecycleWorker.h"
+#include "ThreadPool.h"
+#include "UploadContext.h"
+#include "PluginWindowCache.h"
+#include "PluginProfiler.h"
+#include "SessionStore.h"
+#include "MemoryBudget.h"
 
 class WindowManager {
 public:
     using WindowIterator = std::function<void(std::shared_ptr<Window>)>;
 
-    WindowManager();
+    WindowManager(const std::string &sessionPath);
 
+    // pre-generates GL objects for moved windows, needs a GL context
+    void warmUp();
     void onVRStateChanged(bool inVr);
+    void onPlaneReload();
     void addTriggerReceiver(XPLMWindowID wnd);
     void removeTriggerReceiver(XPLMWindowID wnd);
     bool isTriggerReceiver(XPLMWindowID wnd);
+    // clicks inside the region go only to this receiver, at the matching window coordinates
+    void setTriggerRegion(XPLMWindowID wnd, const PanelRegions::Region &region);
+    PanelRegions::Region getTriggerRegion(XPLMWindowID wnd);
 
     void update();
-    void checkForClose();
+    // uiBytes is the video memory used by our own widgets
+    void checkForClose(size_t uiBytes);
     void forEachWindow(WindowIterator f);
 
     std::shared_ptr<XPlaneWindowList> getXPlaneWindows();
+    std::shared_ptr<DesktopCapture> getDesktopCapture();
+    std::shared_ptr<MemoryBudget> getMemoryBudget();
+    std::shared_ptr<PluginWindowCache> getPluginWindowCache();
+    std::shared_ptr<PluginProfiler> getPluginProfiler();
 
     std::shared_ptr<MovedWindow> moveToVR(std::shared_ptr<Window> window);
     std::shared_ptr<MovedWindow> findMovedWindow(std::shared_ptr<Window> window);
 
-    void closeVRWindows();
+    // VR windows are suspended when leaving VR and resumed when entering it again
+    void suspendVRWindows();
+    void resumeWindows();
+    void setReleaseOnSuspend(bool release);
+    bool getReleaseOnSuspend();
+    // only affects windows that are moved afterwards
+    void setSharedUpload(bool enable);
+    bool getSharedUpload();
+    void saveSession();
+    // closes all windows and waits a bit for their threads, returns false if some are still running
+    bool shutdown();
 
 private:
     bool isInVR = false;
     std::set<XPLMWindowID> triggerReceivers;
+    PanelRegions panelRegions;
+    XPLMWindowID activeReceiver {};
     VRTriggerCapturer vrCapturer;
+    WindowDiscovery windowDiscovery;
+    uint64_t knownGeneration = 0;
     std::vector<std::shared_ptr<Window>> systemWindows;
     std::shared_ptr<XPlaneWindowList> xplaneWindows;
+    std::shared_ptr<PluginWindowCache> pluginWindowCache;
+    std::shared_ptr<PluginProfiler> pluginProfiler;
+    std::shared_ptr<DesktopCapture> desktopCapture;
+    std::shared_ptr<MemoryBudget> memoryBudget;
+    // declared before the moved windows so that they outlive them
+    std::shared_ptr<GLObjectPool> glPool;
+    std::shared_ptr<LifecycleWorker> lifecycleWorker;
+    std::shared_ptr<ThreadPool> workerPool;
+    std::shared_ptr<UploadContext> uploadContext;
     std::map<std::shared_ptr<Window>, std::shared_ptr<MovedWindow>> movedWindows;
+
+    // windows that weren't restored yet, either released on suspend or loaded from the session file
+    struct PendingWindow {
+        SessionStore::WindowState state;
+        // only set for windows released in this session, loaded ones are matched by process and title
+        std::shared_ptr<Window> window;
+    };
+    SessionStore sessionStore;
+    std::vector<PendingWindow> pendingWindows;
+    bool releaseOnSuspend = false;
+    bool largePages = false;
+    bool sharedUpload = false;
+    bool resumeAfterReload = false;
+
+    SessionStore::WindowState getState(std::shared_ptr<Window> window, std::shared_ptr<MovedWindow> moved);
+    void applyState(std::shared_ptr<MovedWindow> moved, const SessionStore::WindowState &state);
+    void restorePendingWindows();
+    void onPanelTrigger(XPLMMouseStatus status, float px, float py);
 };
 
 #endif /* SRC_MOVEVR_WINDOWMANAGER_H_ */
@@ -0,0 +1,146 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Standalone Win32 benchmark for the shared desktop capture, doesn't need the sim.
+ * Opens N windows and compares grabbing each of them with GetWindowDC and StretchBlt
+ * against one DesktopCapture cycle that grabs the desktop once for all of them.
+ * Both run on a single thread, so this measures the cost and not the latency.
+ */
+#include <windows.h>
+#include <cstdio>
+#include <chrono>
+#include <vector>
+#include "src/windows/DesktopCapture.h"
+
+namespace {
+    constexpr const int ROUNDS = 100;
+    constexpr const int WINDOW_WIDTH = 320;
+    constexpr const int WINDOW_HEIGHT = 240;
+    constexpr const int COLUMNS = 4;
+    constexpr const int WINDOW_COUNTS[] = {2, 4, 8, 16};
+
+    struct Target {
+        HWND wnd {};
+        HDC memDC {};
+        HBITMAP bitmap {}, origBitmap {};
+    };
+
+    void pumpMessages() {
+        MSG msg;
+        while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+    }
+
+    std::vector<Target> openWindows(int count) {
+        std::vector<Target> targets;
+        HDC screenDC = GetDC(nullptr);
+        for (int i = 0; i < count; i++) {
+            Target target;
+            int x = (i % COLUMNS) * WINDOW_WIDTH;
+            int y = (i / COLUMNS) * WINDOW_HEIGHT;
+            target.wnd = CreateWindowExW(0, L"MoveVRBench", L"MoveVR benchmark", WS_POPUP | WS_VISIBLE,
+                    x, y, WINDOW_WIDTH, WINDOW_HEIGHT, nullptr, nullptr, GetModuleHandleW(nullptr), nullptr);
+            target.memDC = CreateCompatibleDC(screenDC);
+            target.bitmap = CreateCompatibleBitmap(screenDC, WINDOW_WIDTH, WINDOW_HEIGHT);
+            target.origBitmap = (HBITMAP) SelectObject(target.memDC, target.bitmap);
+            SetStretchBltMode(target.memDC, STRETCH_HALFTONE);
+            targets.push_back(target);
+        }
+        ReleaseDC(nullptr, screenDC);
+        pumpMessages();
+        return targets;
+    }
+
+    void closeWindows(std::vector<Target> &targets) {
+        for (auto &target: targets) {
+            SelectObject(target.memDC, target.origBitmap);
+            DeleteObject(target.bitmap);
+            DeleteDC(target.memDC);
+            DestroyWindow(target.wnd);
+        }
+        targets.clear();
+        pumpMessages();
+    }
+
+    void grabWindows(std::vector<Target> &targets) {
+        for (auto &target: targets) {
+            // what each window does on its own without the shared capture
+            HDC windowDC = GetWindowDC(target.wnd);
+            StretchBlt(target.memDC, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, windowDC, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, SRCCOPY);
+            ReleaseDC(target.wnd, windowDC);
+        }
+    }
+
+    void copyShared(DesktopCapture &capture, std::vector<Target> &targets, const std::vector<uint64_t> &tokens) {
+        for (size_t i = 0; i < targets.size(); i++) {
+            RECT rect;
+            GetWindowRect(targets[i].wnd, &rect);
+            capture.copyRegion(&targets[i], tokens[i], rect, targets[i].memDC, WINDOW_WIDTH, WINDOW_HEIGHT, STRETCH_HALFTONE);
+        }
+    }
+
+    template<typename F>
+    double millisPerRound(F round) {
+        round();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ROUNDS; i++) {
+            round();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+    }
+}
+
+int main() {
+    SetProcessDPIAware();
+
+    WNDCLASSW wc {};
+    wc.lpfnWndProc = DefWindowProcW;
+    wc.hInstance = GetModuleHandleW(nullptr);
+    wc.hbrBackground = (HBRUSH) GetStockObject(GRAY_BRUSH);
+    wc.lpszClassName = L"MoveVRBench";
+    RegisterClassW(&wc);
+
+    printf("%-8s %18s %18s\n", "windows", "separate ms/cycle", "shared ms/cycle");
+    for (int count: WINDOW_COUNTS) {
+        auto targets = openWindows(count);
+
+        double separate = millisPerRound([&targets] {
+            grabWindows(targets);
+        });
+
+        DesktopCapture capture;
+        std::vector<uint64_t> tokens;
+        for (auto &target: targets) {
+            tokens.push_back(capture.addClient(&target));
+        }
+        double shared = millisPerRound([&capture, &targets, &tokens] {
+            copyShared(capture, targets, tokens);
+        });
+        for (auto &target: targets) {
+            capture.removeClient(&target);
+        }
+
+        printf("%-8d %18.2f %18.2f\n", count, separate, shared);
+        closeWindows(targets);
+    }
+
+    return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Standalone benchmark for ImgWindow's ImGui renderer, doesn't need the sim.
+ * Builds a large ImGui tree once and renders its draw lists into a framebuffer on an
+ * offscreen context, once with the client-side arrays ImgWindow used to pass for every
+ * draw and once from buffer objects that are uploaded once per built frame.
+ * Uses a hidden WGL window on Windows and a surfaceless EGL context elsewhere, which
+ * is a software renderer (llvmpipe) on machines without a GPU.
+ */
+#ifdef _WIN32
+#include <windows.h>
+#include <GL/glew.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include "imgui.h"
+
+namespace {
+    constexpr const int ROUNDS = 50;
+    // tall enough that the whole tree is visible, ImGui doesn't emit vertices for clipped items
+    constexpr const int WIDTH = 1024;
+    constexpr const int HEIGHT = 4096;
+    // stays below the 64k vertices a draw list can have with 16 bit indices
+    constexpr const int TREE_NODES = 30;
+    constexpr const int LINES_PER_NODE = 5;
+
+    bool createContext() {
+#ifdef _WIN32
+        WNDCLASSW wc {};
+        wc.lpfnWndProc = DefWindowProcW;
+        wc.hInstance = GetModuleHandleW(nullptr);
+        wc.lpszClassName = L"MoveVRBench";
+        RegisterClassW(&wc);
+        HWND wnd = CreateWindowExW(0, L"MoveVRBench", L"MoveVR benchmark", WS_OVERLAPPEDWINDOW,
+                0, 0, 64, 64, nullptr, nullptr, wc.hInstance, nullptr);
+        HDC dc = GetDC(wnd);
+
+        PIXELFORMATDESCRIPTOR pfd {};
+        pfd.nSize = sizeof(pfd);
+        pfd.nVersion = 1;
+        pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER;
+        pfd.iPixelType = PFD_TYPE_RGBA;
+        pfd.cColorBits = 32;
+        SetPixelFormat(dc, ChoosePixelFormat(dc, &pfd), &pfd);
+
+        HGLRC context = wglCreateContext(dc);
+        return context && wglMakeCurrent(dc, context) && glewInit() == GLEW_OK;
+#else
+        auto getDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (!getDisplay) {
+            return false;
+        }
+        EGLDisplay display = getDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (!eglInitialize(display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API)) {
+            return false;
+        }
+
+        // the default is a compatibility context, the renderer uses the fixed function pipeline
+        EGLint attribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+        EGLConfig config;
+        EGLint count = 0;
+        eglChooseConfig(display, attribs, &config, 1, &count);
+        EGLContext context = eglCreateContext(display, count > 0 ? config : nullptr, EGL_NO_CONTEXT, nullptr);
+        return context != EGL_NO_CONTEXT && eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+#endif
+    }
+
+    GLuint createTarget() {
+        GLuint texture, fbo;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WIDTH, HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        return fbo;
+    }
+
+    GLuint createFontTexture() {
+        unsigned char *pixels;
+        int width, height;
+        ImGui::GetIO().Fonts->GetTexDataAsAlpha8(&pixels, &width, &height);
+
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, width, height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, pixels);
+        ImGui::GetIO().Fonts->TexID = (void *)(intptr_t) texture;
+        return texture;
+    }
+
+    // similar to the manager widget, but with many more windows
+    ImDrawData *buildTree() {
+        auto &io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(WIDTH, HEIGHT);
+        io.DeltaTime = 1.0f / 60;
+        ImGui::NewFrame();
+
+        ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
+        ImGui::SetNextWindowSize(ImVec2(WIDTH, HEIGHT), ImGuiCond_Always);
+        ImGui::Begin("Benchmark", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse);
+        for (int node = 0; node < TREE_NODES; node++) {
+            if (ImGui::TreeNodeEx((void *)(intptr_t) node, ImGuiTreeNodeFlags_DefaultOpen, "Window %d - Some Application", node)) {
+                bool checked = node % 2 == 0;
+                ImGui::Checkbox("Show cursor", &checked);
+                for (int line = 0; line < LINES_PER_NODE; line++) {
+                    ImGui::Text("Capture %.2f ms, wait %.2f ms, publish %.2f ms, interval %.2f ms",
+                            node * 0.1f, line * 0.2f, node * 0.3f, line * 0.4f);
+                }
+                ImGui::TreePop();
+            }
+        }
+        ImGui::End();
+        ImGui::Render();
+        return ImGui::GetDrawData();
+    }
+
+    void beginRender() {
+        glViewport(0, 0, WIDTH, HEIGHT);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        glOrtho(0, WIDTH, HEIGHT, 0, -1, 1);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_SCISSOR_TEST);
+        glEnable(GL_TEXTURE_2D);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+    }
+
+    // the vertex pointers are either client memory or offsets into the bound buffer objects
+    void drawLists(ImDrawData *drawData, bool fromBuffers) {
+        intptr_t vtxOffset = 0, idxOffset = 0;
+        for (int n = 0; n < drawData->CmdListsCount; n++) {
+            const ImDrawList *cmdList = drawData->CmdLists[n];
+            const char *vtx = fromBuffers ? (const char *) vtxOffset : (const char *) cmdList->VtxBuffer.Data;
+            const char *idx = fromBuffers ? (const char *) idxOffset : (const char *) cmdList->IdxBuffer.Data;
+            glVertexPointer(2, GL_FLOAT, sizeof(ImDrawVert), vtx + IM_OFFSETOF(ImDrawVert, pos));
+            glTexCoordPointer(2, GL_FLOAT, sizeof(ImDrawVert), vtx + IM_OFFSETOF(ImDrawVert, uv));
+            glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ImDrawVert), vtx + IM_OFFSETOF(ImDrawVert, col));
+
+            for (int i = 0; i < cmdList->CmdBuffer.Size; i++) {
+                const ImDrawCmd *cmd = &cmdList->CmdBuffer[i];
+                glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t) cmd->TextureId);
+                glScissor((int) cmd->ClipRect.x, (int) (HEIGHT - cmd->ClipRect.w),
+                        (int) (cmd->ClipRect.z - cmd->ClipRect.x), (int) (cmd->ClipRect.w - cmd->ClipRect.y));
+                glDrawElements(GL_TRIANGLES, (GLsizei) cmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx);
+                idx += cmd->ElemCount * sizeof(ImDrawIdx);
+            }
+            vtxOffset += cmdList->VtxBuffer.Size * sizeof(ImDrawVert);
+            idxOffset += cmdList->IdxBuffer.Size * sizeof(ImDrawIdx);
+        }
+    }
+
+    // what ImgWindow::uploadDrawData does once per built frame
+    void upload(ImDrawData *drawData) {
+        glBufferData(GL_ARRAY_BUFFER, drawData->TotalVtxCount * sizeof(ImDrawVert), nullptr, GL_STREAM_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, drawData->TotalIdxCount * sizeof(ImDrawIdx), nullptr, GL_STREAM_DRAW);
+
+        GLintptr vtxOffset = 0, idxOffset = 0;
+        for (int n = 0; n < drawData->CmdListsCount; n++) {
+            const ImDrawList *cmdList = drawData->CmdLists[n];
+            GLsizeiptr vtxSize = cmdList->VtxBuffer.Size * sizeof(ImDrawVert);
+            GLsizeiptr idxSize = cmdList->IdxBuffer.Size * sizeof(ImDrawIdx);
+            glBufferSubData(GL_ARRAY_BUFFER, vtxOffset, vtxSize, cmdList->VtxBuffer.Data);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, idxOffset, idxSize, cmdList->IdxBuffer.Data);
+            vtxOffset += vtxSize;
+            idxOffset += idxSize;
+        }
+    }
+
+    double millisPerRound(const std::function<void()> &round) {
+        round();
+        glFinish();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ROUNDS; i++) {
+            round();
+        }
+        glFinish();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+    }
+}
+
+int main() {
+    if (!createContext()) {
+        fprintf(stderr, "No OpenGL context\n");
+        return 1;
+    }
+    printf("Renderer: %s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+    ImGuiContext *imgui = ImGui::CreateContext();
+    ImGui::GetIO().IniFilename = nullptr;
+    GLuint fontTexture = createFontTexture();
+    GLuint fbo = createTarget();
+
+    ImDrawData *drawData = buildTree();
+    printf("Draw data: %d lists, %d vertices, %d indices\n", drawData->CmdListsCount, drawData->TotalVtxCount, drawData->TotalIdxCount);
+
+    beginRender();
+    GLuint buffers[2];
+    glGenBuffers(2, buffers);
+
+    // a software renderer spends most of its time filling pixels, the second pass only submits the vertices
+    printf("%-28s %12s %12s\n", "path", "ms", "no raster ms");
+    double results[2][3];
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            glEnable(GL_RASTERIZER_DISCARD);
+        }
+
+        results[pass][0] = millisPerRound([drawData] {
+            drawLists(drawData, false);
+        });
+
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+        results[pass][1] = millisPerRound([drawData] {
+            upload(drawData);
+            drawLists(drawData, true);
+        });
+        results[pass][2] = millisPerRound([drawData] {
+            drawLists(drawData, true);
+        });
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    printf("%-28s %12.3f %12.3f\n", "client arrays", results[0][0], results[1][0]);
+    printf("%-28s %12.3f %12.3f\n", "buffers, upload and draw", results[0][1], results[1][1]);
+    printf("%-28s %12.3f %12.3f\n", "buffers, replay", results[0][2], results[1][2]);
+    // in VR the same frame is drawn once per eye
+    printf("%-28s %12.3f %12.3f\n", "client arrays, both eyes", results[0][0] * 2, results[1][0] * 2);
+    printf("%-28s %12.3f %12.3f\n", "buffers, both eyes", results[0][1] + results[0][2], results[1][1] + results[1][2]);
+
+    glDeleteBuffers(2, buffers);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &fontTexture);
+    ImGui::DestroyContext(imgui);
+    return 0;
+}
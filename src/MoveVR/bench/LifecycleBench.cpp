@@ -0,0 +1,244 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Standalone benchmark for the cost that moving and closing a window puts on the sim thread,
+ * doesn't need the sim. A window is modelled by what MovedWindow creates on the sim thread:
+ * two pixel buffers, a texture, a capture thread and an input thread. Once they are created
+ * and destroyed directly and once with the GL object pool and the lifecycle worker.
+ * Uses a hidden WGL window on Windows and a surfaceless EGL context elsewhere.
+ */
+#ifdef _WIN32
+#include <windows.h>
+#include <GL/glew.h>
+#else
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "src/MoveVR/GLObjectPool.h"
+#include "src/MoveVR/LifecycleWorker.h"
+
+namespace {
+    constexpr const int ROUNDS = 50;
+    // the storage the buffers and the texture have when a 1080p window is closed
+    constexpr const int FRAME_WIDTH = 1920;
+    constexpr const int FRAME_HEIGHT = 1080;
+    // the capture loop's sleep while it waits for the next frame with no delay set
+    constexpr const std::chrono::milliseconds CAPTURE_SLEEP(1);
+
+    bool createContext() {
+#ifdef _WIN32
+        WNDCLASSW wc {};
+        wc.lpfnWndProc = DefWindowProcW;
+        wc.hInstance = GetModuleHandleW(nullptr);
+        wc.lpszClassName = L"MoveVRBench";
+        RegisterClassW(&wc);
+        HWND wnd = CreateWindowExW(0, L"MoveVRBench", L"MoveVR benchmark", WS_OVERLAPPEDWINDOW,
+                0, 0, 64, 64, nullptr, nullptr, wc.hInstance, nullptr);
+        HDC dc = GetDC(wnd);
+
+        PIXELFORMATDESCRIPTOR pfd {};
+        pfd.nSize = sizeof(pfd);
+        pfd.nVersion = 1;
+        pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER;
+        pfd.iPixelType = PFD_TYPE_RGBA;
+        pfd.cColorBits = 32;
+        SetPixelFormat(dc, ChoosePixelFormat(dc, &pfd), &pfd);
+
+        HGLRC context = wglCreateContext(dc);
+        return context && wglMakeCurrent(dc, context) && glewInit() == GLEW_OK;
+#else
+        auto getDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (!getDisplay) {
+            return false;
+        }
+        EGLDisplay display = getDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (!eglInitialize(display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API)) {
+            return false;
+        }
+
+        EGLint attribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+        EGLConfig config;
+        EGLint count = 0;
+        eglChooseConfig(display, attribs, &config, 1, &count);
+        EGLContext context = eglCreateContext(display, count > 0 ? config : nullptr, EGL_NO_CONTEXT, nullptr);
+        if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            return false;
+        }
+        // without a GLX display GLEW reports an error, but the GL functions are loaded anyway
+        glewInit();
+        return true;
+#endif
+    }
+
+    // stands in for the capture and input threads, both stop within a short sleep
+    struct Threads {
+        std::atomic_bool stop { false };
+        std::thread capture, input;
+
+        void start() {
+            capture = std::thread([this] {
+                while (!stop) {
+                    std::this_thread::sleep_for(CAPTURE_SLEEP);
+                }
+            });
+            input = std::thread([this] {
+                while (!stop) {
+                    std::this_thread::sleep_for(CAPTURE_SLEEP);
+                }
+            });
+        }
+
+        void join() {
+            capture.join();
+            input.join();
+        }
+    };
+
+    struct Window {
+        GLuint buffers[2] {};
+        GLuint texture = 0;
+        std::shared_ptr<Threads> threads = std::make_shared<Threads>();
+    };
+
+    void bindTexture(unsigned int texture) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    // done by the first frames after moving, not part of the measured move
+    void allocateStorage(Window &window) {
+        size_t bytes = (size_t) FRAME_WIDTH * FRAME_HEIGHT * 3;
+        for (GLuint buffer: window.buffers) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        bindTexture(window.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, FRAME_WIDTH, FRAME_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        glFinish();
+    }
+
+    void moveDirect(Window &window) {
+        glGenBuffers(2, window.buffers);
+        glGenTextures(1, &window.texture);
+        bindTexture(window.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        window.threads->start();
+    }
+
+    void closeDirect(Window &window) {
+        window.threads->stop = true;
+        window.threads->join();
+        glDeleteBuffers(2, window.buffers);
+        glDeleteTextures(1, &window.texture);
+    }
+
+    void movePooled(Window &window, GLObjectPool &pool, LifecycleWorker &worker) {
+        window.buffers[0] = pool.acquireBuffer();
+        window.buffers[1] = pool.acquireBuffer();
+        window.texture = pool.acquireTexture();
+        auto threads = window.threads;
+        worker.post([threads] {
+            threads->start();
+        });
+    }
+
+    void closePooled(Window &window, GLObjectPool &pool, LifecycleWorker &worker) {
+        auto threads = window.threads;
+        threads->stop = true;
+        worker.post([threads] {
+            threads->join();
+        });
+        pool.releaseBuffer(window.buffers[0]);
+        pool.releaseBuffer(window.buffers[1]);
+        pool.releaseTexture(window.texture);
+        pool.trim();
+    }
+
+    struct Stats {
+        double total = 0, max = 0;
+
+        void add(double millis) {
+            total += millis;
+            max = std::max(max, millis);
+        }
+    };
+
+    template<typename F>
+    double measure(F f) {
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        f();
+        // include the driver's work, not just queueing the commands
+        glFinish();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void print(const char *name, const Stats &move, const Stats &close) {
+        printf("%-16s %12.3f %12.3f %12.3f %12.3f\n", name,
+                move.total / ROUNDS, move.max, close.total / ROUNDS, close.max);
+    }
+}
+
+int main() {
+    if (!createContext()) {
+        fprintf(stderr, "No OpenGL context\n");
+        return 1;
+    }
+
+    Stats directMove, directClose;
+    for (int i = 0; i < ROUNDS; i++) {
+        Window window;
+        directMove.add(measure([&] { moveDirect(window); }));
+        allocateStorage(window);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        directClose.add(measure([&] { closeDirect(window); }));
+    }
+
+    auto pool = std::make_shared<GLObjectPool>(bindTexture);
+    LifecycleWorker worker;
+    // the same warm-up as the window manager
+    pool->warmUp(4, 2);
+
+    Stats pooledMove, pooledClose;
+    for (int i = 0; i < ROUNDS; i++) {
+        Window window;
+        pooledMove.add(measure([&] { movePooled(window, *pool, worker); }));
+        allocateStorage(window);
+        // the worker must have started the threads before the close, as in the plugin
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pooledClose.add(measure([&] { closePooled(window, *pool, worker); }));
+    }
+    worker.shutdown(std::chrono::milliseconds(1000));
+
+    printf("sim thread cost per window, %d rounds, %dx%d frames\n", ROUNDS, FRAME_WIDTH, FRAME_HEIGHT);
+    printf("%-16s %12s %12s %12s %12s\n", "method", "move avg ms", "move max ms", "close avg ms", "close max ms");
+    print("direct", directMove, directClose);
+    print("pool + worker", pooledMove, pooledClose);
+
+    return 0;
+}
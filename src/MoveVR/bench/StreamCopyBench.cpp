@@ -0,0 +1,163 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Standalone benchmark for the copies into mapped pixel buffers, doesn't need the sim.
+ * Compares memcpy with the streaming copies, once into normal memory and once into
+ * write-combined memory, which is what mapped pixel buffers usually are.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "src/MoveVR/StreamCopy.h"
+#include "src/MoveVR/ThreadPool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+    constexpr const int ROUNDS = 50;
+
+    struct Frame {
+        const char *name;
+        size_t width, height;
+    };
+
+    constexpr const Frame FRAMES[] = {
+        {"1024x768", 1024, 768},
+        {"1920x1080", 1920, 1080},
+        {"3840x2160", 3840, 2160},
+    };
+
+    // normal memory is always available, write-combined memory only where the OS lets us map it
+    class Memory {
+    public:
+        Memory(size_t bytes, bool writeCombined) {
+#ifdef _WIN32
+            DWORD protect = PAGE_READWRITE | (writeCombined ? PAGE_WRITECOMBINE : 0);
+            data = static_cast<uint8_t *>(VirtualAlloc(nullptr, bytes, MEM_COMMIT | MEM_RESERVE, protect));
+#else
+            if (!writeCombined) {
+                data = static_cast<uint8_t *>(aligned_alloc(4096, (bytes + 4095) & ~(size_t) 4095));
+            }
+#endif
+            if (data) {
+                // commit the pages before measuring
+                memset(data, 0, bytes);
+            }
+        }
+
+        uint8_t *get() {
+            return data;
+        }
+
+        ~Memory() {
+#ifdef _WIN32
+            if (data) {
+                VirtualFree(data, 0, MEM_RELEASE);
+            }
+#else
+            free(data);
+#endif
+        }
+    private:
+        uint8_t *data = nullptr;
+    };
+
+    using Copy = std::function<void(void *dst, const void *src, size_t bytes)>;
+
+    double measure(const Copy &copy, void *dst, const void *src, size_t bytes) {
+        copy(dst, src, bytes);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ROUNDS; i++) {
+            copy(dst, src, bytes);
+        }
+        auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return bytes * (double) ROUNDS / duration / (1024 * 1024 * 1024);
+    }
+}
+
+int main() {
+    size_t cores = std::thread::hardware_concurrency();
+    // as many threads as the plugin would use, but at least one to compare with
+    size_t maxThreads = cores > 4 ? cores / 2 - 1 : 1;
+
+    struct Method {
+        std::string name;
+        std::shared_ptr<ThreadPool> pool;
+    };
+
+    std::vector<Method> methods;
+    methods.push_back({"memcpy", nullptr});
+    methods.push_back({"streamcopy::copy", nullptr});
+    for (size_t threads = 1; threads <= maxThreads; threads++) {
+        methods.push_back({"copyParallel(" + std::to_string(threads + 1) + " parts)", std::make_shared<ThreadPool>(threads)});
+    }
+
+    printf("%-12s %-26s %16s %16s\n", "frame", "method", "normal GiB/s", "wc GiB/s");
+    for (auto &frame: FRAMES) {
+        size_t bytes = frame.width * frame.height * 4;
+        std::vector<uint8_t> src(bytes);
+        for (size_t i = 0; i < bytes; i++) {
+            src[i] = (uint8_t) i;
+        }
+
+        Memory normal(bytes, false);
+        Memory writeCombined(bytes, true);
+
+        for (auto &method: methods) {
+            Copy copy;
+            if (method.pool) {
+                ThreadPool *pool = method.pool.get();
+                copy = [pool] (void *dst, const void *src, size_t bytes) {
+                    streamcopy::copyParallel(*pool, dst, src, bytes);
+                };
+            } else if (method.name == "memcpy") {
+                copy = [] (void *dst, const void *src, size_t bytes) {
+                    memcpy(dst, src, bytes);
+                };
+            } else {
+                copy = streamcopy::copy;
+            }
+
+            double normalRate = measure(copy, normal.get(), src.data(), bytes);
+            if (writeCombined.get()) {
+                double wcRate = measure(copy, writeCombined.get(), src.data(), bytes);
+                printf("%-12s %-26s %16.2f %16.2f\n", frame.name, method.name.c_str(), normalRate, wcRate);
+            } else {
+                printf("%-12s %-26s %16.2f %16s\n", frame.name, method.name.c_str(), normalRate, "n/a");
+            }
+        }
+    }
+
+    for (auto &method: methods) {
+        if (method.pool) {
+            method.pool->shutdown();
+        }
+    }
+
+    return 0;
+}
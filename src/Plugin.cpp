@@ -47,7 +47,7 @@ PLUGIN_API int XPluginStart(char *outName, char *outSignature, char *outDescript
     try {
         logger::init(getPluginPath());
         logger::setStdOut(true);
-        moveVR = std::make_unique<MoveVR>();
+        moveVR = std::make_unique<MoveVR>(getPluginPath());
         strncpy(outDescription, "Move native windows into VR.", 255);
     } catch (const std::exception &e) {
         logger::error("Exception in XPluginStart: %s", e.what());
@@ -106,8 +106,15 @@ PLUGIN_API void XPluginDisable(void) {
 PLUGIN_API void XPluginStop(void) {
     try {
         logger::verbose("Stopping plugin...");
+        bool stopped = !moveVR || moveVR->shutdown();
         moveVR.reset();
-        if (gdiplusToken) {
+        if (!stopped) {
+            // captures stuck in hung applications still run our code and use GDI+
+            logger::warn("Keeping the plugin loaded, some captures didn't finish");
+            HMODULE module;
+            GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+                    reinterpret_cast<LPCWSTR>(&XPluginStop), &module);
+        } else if (gdiplusToken) {
             Gdiplus::GdiplusShutdown(gdiplusToken);
         }
         logger::verbose("Stopped");
@@ -0,0 +1,130 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include "Cursor.h"
+#include "src/Logger.h"
+
+bool Cursor::update() {
+    CURSORINFO info {};
+    info.cbSize = sizeof(info);
+    if (!GetCursorInfo(&info)) {
+        visible = false;
+        return false;
+    }
+
+    visible = (info.flags & CURSOR_SHOWING) && info.hCursor;
+    position = info.ptScreenPos;
+
+    if (visible && info.hCursor != handle) {
+        handle = info.hCursor;
+        rasterize(handle);
+        shapeVersion++;
+    }
+
+    return visible;
+}
+
+void Cursor::rasterize(HCURSOR cursor) {
+    ICONINFO iconInfo {};
+    if (!GetIconInfo(cursor, &iconInfo)) {
+        shape = Shape{};
+        return;
+    }
+
+    BITMAP mask {};
+    GetObject(iconInfo.hbmMask, sizeof(mask), &mask);
+
+    shape.hotX = iconInfo.xHotspot;
+    shape.hotY = iconInfo.yHotspot;
+    shape.width = mask.bmWidth;
+    // monochrome cursors have the AND and XOR masks stacked in the mask bitmap
+    shape.height = iconInfo.hbmColor ? mask.bmHeight : mask.bmHeight / 2;
+
+    if (iconInfo.hbmColor) {
+        DeleteObject(iconInfo.hbmColor);
+    }
+    DeleteObject(iconInfo.hbmMask);
+
+    BITMAPINFO bmi {};
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = shape.width;
+    bmi.bmiHeader.biHeight = -shape.height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    HDC screenDC = GetDC(nullptr);
+    HDC memDC = CreateCompatibleDC(screenDC);
+    void *bits = nullptr;
+    HBITMAP dib = CreateDIBSection(memDC, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    ReleaseDC(nullptr, screenDC);
+
+    if (!dib || !bits) {
+        DeleteDC(memDC);
+        shape = Shape{};
+        return;
+    }
+
+    HGDIOBJ origBitmap = SelectObject(memDC, dib);
+    size_t size = shape.width * shape.height * 4;
+
+    // draw on black and on white to recover the alpha channel, this also works for monochrome cursors
+    std::vector<uint8_t> onBlack(size), onWhite(size);
+    memset(bits, 0x00, size);
+    DrawIconEx(memDC, 0, 0, cursor, shape.width, shape.height, 0, nullptr, DI_NORMAL);
+    GdiFlush();
+    memcpy(onBlack.data(), bits, size);
+
+    memset(bits, 0xFF, size);
+    DrawIconEx(memDC, 0, 0, cursor, shape.width, shape.height, 0, nullptr, DI_NORMAL);
+    GdiFlush();
+    memcpy(onWhite.data(), bits, size);
+
+    SelectObject(memDC, origBitmap);
+    DeleteObject(dib);
+    DeleteDC(memDC);
+
+    shape.pixels.resize(size);
+    for (size_t i = 0; i < size; i += 4) {
+        // the difference between both backgrounds is what shines through
+        // inverting pixels of monochrome cursors end up as opaque white
+        int alpha = 255 - (onWhite[i + 1] - onBlack[i + 1]);
+        alpha = alpha < 0 ? 0 : (alpha > 255 ? 255 : alpha);
+        for (int c = 0; c < 3; c++) {
+            int color = alpha > 0 ? (onBlack[i + c] * 255 / alpha) : 0;
+            shape.pixels[i + c] = color > 255 ? 255 : color;
+        }
+        shape.pixels[i + 3] = alpha;
+    }
+}
+
+int Cursor::getX() const {
+    return position.x;
+}
+
+int Cursor::getY() const {
+    return position.y;
+}
+
+const Cursor::Shape &Cursor::getShape() const {
+    return shape;
+}
+
+int Cursor::getShapeVersion() const {
+    return shapeVersion;
+}
@@ -0,0 +1,55 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_WINDOWS_CURSOR_H_
+#define SRC_WINDOWS_CURSOR_H_
+
+#include <windows.h>
+#include <vector>
+#include <cstdint>
+
+/*
+ * Tracks the system's mouse cursor independently of the window captures.
+ * Polling the position is cheap, the shape is only rasterized when it changes.
+ */
+class Cursor {
+public:
+    struct Shape {
+        int width = 0, height = 0;
+        int hotX = 0, hotY = 0;
+        // BGRA, top-down
+        std::vector<uint8_t> pixels;
+    };
+
+    // returns true if the cursor is visible
+    bool update();
+
+    int getX() const;
+    int getY() const;
+    const Shape &getShape() const;
+    int getShapeVersion() const;
+private:
+    HCURSOR handle {};
+    bool visible = false;
+    POINT position {};
+    Shape shape;
+    int shapeVersion = 0;
+
+    void rasterize(HCURSOR cursor);
+};
+
+#endif /* SRC_WINDOWS_CURSOR_H_ */
@@ -0,0 +1,175 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "DesktopCapture.h"
+#include "src/Logger.h"
+
+DesktopCapture::DesktopCapture() {
+}
+
+uint64_t DesktopCapture::addClient(const void *client) {
+    std::lock_guard<std::shared_timed_mutex> lock(mutex);
+    Client &info = clients[client];
+    info.token = ++lastToken;
+    return info.token;
+}
+
+bool DesktopCapture::copyRegion(const void *client, uint64_t token, const RECT &screenRect, HDC destDC, int destWidth, int destHeight, int stretchMode) {
+    {
+        std::lock_guard<std::shared_timed_mutex> lock(mutex);
+
+        auto it = clients.find(client);
+        if (it == clients.end() || it->second.token != token) {
+            return false;
+        }
+        Client &info = it->second;
+        info.rect = screenRect;
+
+        // the client already used the current snapshot, so this is the start of a new cycle
+        if (info.generation == generation || !containsRect(snapRect, screenRect)) {
+            grab();
+        }
+        info.generation = generation;
+    }
+
+    // the scaling only reads the snapshot, so the clients can do it in parallel.
+    // Another client can grab a newer snapshot in between, it covers our rectangle as well.
+    std::shared_lock<std::shared_timed_mutex> lock(mutex);
+    if (!snapBits || !containsRect(snapRect, screenRect)) {
+        return true;
+    }
+
+    int srcX = screenRect.left - snapRect.left;
+    int srcY = screenRect.top - snapRect.top;
+    int srcWidth = screenRect.right - screenRect.left;
+    int srcHeight = screenRect.bottom - screenRect.top;
+
+    // reading from the bits instead of the memory DC because a DC can't be shared between threads
+    if (srcWidth != destWidth || srcHeight != destHeight) {
+        SetStretchBltMode(destDC, stretchMode);
+    }
+    // the snapshot is a bottom-up DIB, so the source origin is its lower left corner
+    StretchDIBits(destDC, 0, 0, destWidth, destHeight,
+            srcX, snapHeight - (srcY + srcHeight), srcWidth, srcHeight,
+            snapBits, &snapInfo, DIB_RGB_COLORS, SRCCOPY);
+    return true;
+}
+
+void DesktopCapture::removeClient(const void *client) {
+    std::lock_guard<std::shared_timed_mutex> lock(mutex);
+    clients.erase(client);
+
+    if (clients.empty()) {
+        releaseSnapshot();
+    }
+}
+
+size_t DesktopCapture::getMemoryUsage() {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex);
+    return (size_t) snapWidth * snapHeight * 4;
+}
+
+void DesktopCapture::releaseSnapshot() {
+    if (snapDC) {
+        SelectObject(snapDC, origBitmap);
+        DeleteObject(snapBitmap);
+        DeleteDC(snapDC);
+        snapDC = {};
+        snapBitmap = {};
+        origBitmap = {};
+        snapBits = nullptr;
+    }
+    snapWidth = snapHeight = 0;
+    snapRect = {};
+}
+
+void DesktopCapture::grab() {
+    // the covering rectangle of all clients, registered clients that didn't copy yet have no rectangle
+    RECT cover {};
+    bool empty = true;
+    for (auto &it: clients) {
+        const RECT &rect = it.second.rect;
+        if (rect.right <= rect.left || rect.bottom <= rect.top) {
+            continue;
+        }
+        if (empty) {
+            cover = rect;
+            empty = false;
+            continue;
+        }
+        cover.left = rect.left < cover.left ? rect.left : cover.left;
+        cover.top = rect.top < cover.top ? rect.top : cover.top;
+        cover.right = rect.right > cover.right ? rect.right : cover.right;
+        cover.bottom = rect.bottom > cover.bottom ? rect.bottom : cover.bottom;
+    }
+
+    if (empty) {
+        return;
+    }
+
+    int width = cover.right - cover.left;
+    int height = cover.bottom - cover.top;
+
+    HDC screenDC = GetDC(nullptr);
+    resizeSnapshot(screenDC, width, height);
+    BitBlt(snapDC, 0, 0, width, height, screenDC, cover.left, cover.top, SRCCOPY);
+    ReleaseDC(nullptr, screenDC);
+
+    // make sure the bits are written before other threads read them
+    GdiFlush();
+
+    snapRect = cover;
+    generation++;
+}
+
+void DesktopCapture::resizeSnapshot(HDC screenDC, int width, int height) {
+    // only grow to avoid re-allocations while windows are moved around
+    if (width <= snapWidth && height <= snapHeight) {
+        return;
+    }
+
+    if (snapDC) {
+        SelectObject(snapDC, origBitmap);
+        DeleteObject(snapBitmap);
+        DeleteDC(snapDC);
+    }
+
+    snapWidth = width > snapWidth ? width : snapWidth;
+    snapHeight = height > snapHeight ? height : snapHeight;
+
+    snapInfo = {};
+    snapInfo.bmiHeader.biSize = sizeof(snapInfo.bmiHeader);
+    snapInfo.bmiHeader.biWidth = snapWidth;
+    snapInfo.bmiHeader.biHeight = snapHeight;
+    snapInfo.bmiHeader.biPlanes = 1;
+    snapInfo.bmiHeader.biBitCount = 32;
+    snapInfo.bmiHeader.biCompression = BI_RGB;
+
+    snapDC = CreateCompatibleDC(screenDC);
+    snapBitmap = CreateDIBSection(screenDC, &snapInfo, DIB_RGB_COLORS, &snapBits, nullptr, 0);
+    origBitmap = (HBITMAP) SelectObject(snapDC, snapBitmap);
+    logger::verbose("Desktop snapshot now %dx%d", snapWidth, snapHeight);
+}
+
+bool DesktopCapture::containsRect(const RECT &outer, const RECT &inner) {
+    return inner.left >= outer.left && inner.top >= outer.top &&
+           inner.right <= outer.right && inner.bottom <= outer.bottom;
+}
+
+DesktopCapture::~DesktopCapture() {
+    releaseSnapshot();
+}
@@ -0,0 +1,76 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_WINDOWS_DESKTOPCAPTURE_H_
+#define SRC_WINDOWS_DESKTOPCAPTURE_H_
+
+#include <windows.h>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Coordinates the capturing of several windows so that the desktop is only grabbed once per cycle.
+ * A cycle ends as soon as a client requests a new frame after it already used the current snapshot,
+ * the new snapshot then covers the rectangles of all clients.
+ */
+class DesktopCapture {
+public:
+    DesktopCapture();
+
+    // returns the token that the client has to pass to copyRegion until it is removed
+    uint64_t addClient(const void *client);
+    // copies the given screen rectangle of the current snapshot into the bitmap selected into destDC,
+    // false if the client was removed meanwhile
+    bool copyRegion(const void *client, uint64_t token, const RECT &screenRect, HDC destDC, int destWidth, int destHeight, int stretchMode);
+    void removeClient(const void *client);
+
+    // size of the snapshot, it is released when the last client is removed
+    size_t getMemoryUsage();
+
+    ~DesktopCapture();
+private:
+    struct Client {
+        // identifies the registration, a removed client can't be brought back by a late copy
+        uint64_t token = 0;
+        // empty until the first copy
+        RECT rect {};
+        uint64_t generation = 0;
+    };
+
+    // exclusive for grabbing, shared for scaling from the snapshot
+    std::shared_timed_mutex mutex;
+    std::map<const void *, Client> clients;
+    uint64_t lastToken = 0;
+
+    HDC snapDC {};
+    HBITMAP snapBitmap {}, origBitmap {};
+    BITMAPINFO snapInfo {};
+    void *snapBits = nullptr;
+    int snapWidth = 0, snapHeight = 0;
+    RECT snapRect {};
+    uint64_t generation = 0;
+
+    void grab();
+    void resizeSnapshot(HDC screenDC, int width, int height);
+    void releaseSnapshot();
+    static bool containsRect(const RECT &outer, const RECT &inner);
+};
+
+#endif /* SRC_WINDOWS_DESKTOPCAPTURE_H_ */
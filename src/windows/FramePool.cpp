@@ -0,0 +1,179 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <windows.h>
+#include <malloc.h>
+#include <stdexcept>
+#include "FramePool.h"
+#include "src/Logger.h"
+
+namespace {
+    // smaller buffers aren't worth a size class of their own
+    constexpr const size_t MIN_CLASS = 64 * 1024;
+}
+
+FramePool::Buffer::Buffer(Buffer &&other) noexcept {
+    *this = std::move(other);
+}
+
+FramePool::Buffer &FramePool::Buffer::operator=(Buffer &&other) noexcept {
+    if (this != &other) {
+        reset();
+        pool = other.pool;
+        ptr = other.ptr;
+        used = other.used;
+        cap = other.cap;
+        largePage = other.largePage;
+        other.pool = nullptr;
+        other.ptr = nullptr;
+        other.used = other.cap = 0;
+    }
+    return *this;
+}
+
+void FramePool::Buffer::setSize(size_t size) {
+    if (size > cap) {
+        throw std::runtime_error("Frame buffer too small");
+    }
+    used = size;
+}
+
+void FramePool::Buffer::reset() {
+    if (pool && ptr) {
+        pool->release(Block {ptr, cap, largePage});
+    }
+    pool = nullptr;
+    ptr = nullptr;
+    used = cap = 0;
+}
+
+FramePool::Buffer::~Buffer() {
+    reset();
+}
+
+FramePool &FramePool::shared() {
+    static FramePool pool;
+    return pool;
+}
+
+size_t FramePool::sizeClass(size_t size) {
+    if (size <= MIN_CLASS) {
+        return MIN_CLASS;
+    }
+
+    // round up to a multiple of a quarter of the next lower power of two
+    size_t octave = MIN_CLASS;
+    while (octave * 2 <= size) {
+        octave *= 2;
+    }
+    size_t step = octave / 4;
+    return (size + step - 1) / step * step;
+}
+
+FramePool::Buffer FramePool::acquire(size_t size) {
+    size_t capacity = sizeClass(size);
+
+    Block block {};
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = freeBlocks.find(capacity);
+        if (it != freeBlocks.end() && !it->second.empty()) {
+            block = it->second.back();
+            it->second.pop_back();
+            pooledBytes -= block.capacity;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        block = allocate(capacity);
+    }
+
+    Buffer buf;
+    buf.pool = this;
+    buf.ptr = block.ptr;
+    buf.cap = block.capacity;
+    buf.largePage = block.largePage;
+    buf.used = size;
+    return buf;
+}
+
+FramePool::Block FramePool::allocate(size_t capacity) {
+    if (useLargePages) {
+        size_t pageSize = GetLargePageMinimum();
+        if (pageSize > 0 && capacity >= pageSize) {
+            // the allocation must be a multiple of the page size, the rest stays unused
+            size_t allocSize = (capacity + pageSize - 1) / pageSize * pageSize;
+            void *mem = VirtualAlloc(nullptr, allocSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (mem) {
+                return Block {(uint8_t *) mem, capacity, true};
+            }
+            // usually missing the privilege to lock pages in memory
+            logger::verbose("Large page allocation failed, using regular pages");
+            useLargePages = false;
+        }
+    }
+
+    void *mem = _aligned_malloc(capacity, ALIGNMENT);
+    if (!mem) {
+        throw std::runtime_error("Couldn't allocate frame buffer");
+    }
+    return Block {(uint8_t *) mem, capacity, false};
+}
+
+void FramePool::release(const Block &block) {
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBlocks[block.capacity].push_back(block);
+    pooledBytes += block.capacity;
+}
+
+void FramePool::freeBlock(const Block &block) {
+    if (block.largePage) {
+        VirtualFree(block.ptr, 0, MEM_RELEASE);
+    } else {
+        _aligned_free(block.ptr);
+    }
+}
+
+void FramePool::setUseLargePages(bool use) {
+    useLargePages = use;
+}
+
+size_t FramePool::getPooledBytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pooledBytes;
+}
+
+void FramePool::trim() {
+    std::map<size_t, std::vector<Block>> unused;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        unused.swap(freeBlocks);
+        pooledBytes = 0;
+    }
+
+    for (auto &entry: unused) {
+        for (auto &block: entry.second) {
+            freeBlock(block);
+        }
+    }
+}
+
+FramePool::~FramePool() {
+    trim();
+}
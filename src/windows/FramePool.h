@@ -0,0 +1,93 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_WINDOWS_FRAMEPOOL_H_
+#define SRC_WINDOWS_FRAMEPOOL_H_
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Recycles the large pixel buffers used while capturing so that frames don't allocate
+ * and zero-fill memory in steady state. Buffers are 64 byte aligned for vectorized
+ * code and rounded up to size classes with a quarter of an octave each, so a buffer
+ * can be reused for slightly different frame sizes. Large pages are used if enabled
+ * and allowed by the system.
+ */
+class FramePool {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    // returns its memory to the pool when destroyed
+    class Buffer {
+    public:
+        Buffer() = default;
+        Buffer(Buffer &&other) noexcept;
+        Buffer &operator=(Buffer &&other) noexcept;
+        Buffer(const Buffer &other) = delete;
+        Buffer &operator=(const Buffer &other) = delete;
+        ~Buffer();
+
+        uint8_t *data() const { return ptr; }
+        size_t size() const { return used; }
+        size_t capacity() const { return cap; }
+        bool empty() const { return used == 0; }
+
+        // the contents are kept and new bytes are not initialized
+        void setSize(size_t size);
+        void reset();
+    private:
+        friend class FramePool;
+        FramePool *pool = nullptr;
+        uint8_t *ptr = nullptr;
+        size_t used = 0, cap = 0;
+        bool largePage = false;
+    };
+
+    static FramePool &shared();
+    static size_t sizeClass(size_t size);
+
+    Buffer acquire(size_t size);
+
+    void setUseLargePages(bool use);
+    size_t getPooledBytes();
+    // frees all buffers that are currently not in use
+    void trim();
+
+    ~FramePool();
+private:
+    struct Block {
+        uint8_t *ptr;
+        size_t capacity;
+        bool largePage;
+    };
+
+    std::mutex mutex;
+    std::map<size_t, std::vector<Block>> freeBlocks;
+    size_t pooledBytes = 0;
+    std::atomic_bool useLargePages { false };
+
+    Block allocate(size_t capacity);
+    void release(const Block &block);
+    static void freeBlock(const Block &block);
+};
+
+#endif /* SRC_WINDOWS_FRAMEPOOL_H_ */
@@ -30,50 +30,340 @@ GetDpiForSystem_t GetDpiForSystem_ = (GetDpiForSystem_t) GetProcAddress(u32lib,
 Window::Window(HWND hWnd):
     wnd(hWnd)
 {
+    refreshMetadata();
+}
+
+Window::Window(HMONITOR hMonitor, int index):
+    wnd(GetDesktopWindow()),
+    monitor(hMonitor),
+    monitorIndex(index)
+{
+    refreshMetadata();
 }
 
 bool Window::isEqual(const Window& other) const {
-    return wnd == other.wnd;
+    return wnd == other.wnd && monitor == other.monitor;
+}
+
+bool Window::isDesktop() const {
+    return wnd == GetDesktopWindow();
+}
+
+RECT Window::getSourceRect() const {
+    RECT rect {};
+    if (monitor) {
+        MONITORINFO info {};
+        info.cbSize = sizeof(info);
+        GetMonitorInfoW(monitor, &info);
+        rect = info.rcMonitor;
+    } else {
+        GetWindowRect(wnd, &rect);
+    }
+    return rect;
+}
+
+HDC Window::getSourceDC() const {
+    if (monitor) {
+        // monitors are captured from the screen DC which uses screen coordinates
+        return GetDC(nullptr);
+    } else {
+        return GetWindowDC(wnd);
+    }
+}
+
+void Window::releaseSourceDC(HDC dc) const {
+    ReleaseDC(monitor ? nullptr : wnd, dc);
 }
 
 int Window::getWidth() const {
-    RECT winRect;
-    GetWindowRect(wnd, &winRect);
-    return winRect.right - winRect.left;
+    auto geo = getGeometry();
+    return geo->rect.right - geo->rect.left;
 }
 
 int Window::getHeight() const {
-    RECT winRect;
-    GetWindowRect(wnd, &winRect);
-    return winRect.bottom - winRect.top;
+    auto geo = getGeometry();
+    return geo->rect.bottom - geo->rect.top;
 }
 
 float Window::getAspectRatio() const {
-    RECT winRect;
-    GetWindowRect(wnd, &winRect);
+    return getGeometry()->aspectRatio;
+}
 
-    return (winRect.bottom - winRect.top) / (float) (winRect.right - winRect.left);
+std::shared_ptr<const Window::Geometry> Window::getGeometry() const {
+    return std::atomic_load(&geometry);
+}
+
+std::shared_ptr<const Window::Geometry> Window::updateGeometry() {
+    auto geo = std::make_shared<Geometry>();
+    geo->rect = getSourceRect();
+    geo->region = calculateCaptureRegion(geo->rect);
+
+    if (!monitor && GetDpiForSystem_ && GetDpiForWindow_) {
+        geo->dpi = GetDpiForWindow_(wnd);
+        geo->systemDpi = GetDpiForSystem_();
+    }
+
+    if (!geo->region.isEmpty()) {
+        geo->aspectRatio = geo->region.height / (float) geo->region.width;
+    }
+
+    std::shared_ptr<const Geometry> snapshot = geo;
+    std::atomic_store(&geometry, snapshot);
+    return snapshot;
+}
+
+void Window::setCropRegion(const Region &region) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    cropRegion = region;
+}
+
+Window::Region Window::getCropRegion() const {
+    std::lock_guard<std::mutex> lock(configMutex);
+    return cropRegion;
+}
+
+void Window::setTrimBorders(bool trim) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    trimBorders = trim;
+}
+
+bool Window::getTrimBorders() const {
+    std::lock_guard<std::mutex> lock(configMutex);
+    return trimBorders;
+}
+
+Window::Region Window::calculateCaptureRegion(const RECT &winRect) const {
+    Region full;
+    full.width = winRect.right - winRect.left;
+    full.height = winRect.bottom - winRect.top;
+
+    Region region = full;
+    {
+        std::lock_guard<std::mutex> lock(configMutex);
+        if (!cropRegion.isEmpty()) {
+            region = cropRegion;
+        } else if (trimBorders && !isDesktop()) {
+            // the client area excludes borders, title bar and menu
+            RECT clientRect;
+            POINT clientOrigin {0, 0};
+            if (GetClientRect(wnd, &clientRect) && ClientToScreen(wnd, &clientOrigin)) {
+                region.x = clientOrigin.x - winRect.left;
+                region.y = clientOrigin.y - winRect.top;
+                region.width = clientRect.right - clientRect.left;
+                region.height = clientRect.bottom - clientRect.top;
+            }
+        }
+    }
+
+    // clip to the window so that a stale crop region can't read outside of it
+    int left = region.x > 0 ? region.x : 0;
+    int top = region.y > 0 ? region.y : 0;
+    int right = region.x + region.width < full.width ? region.x + region.width : full.width;
+    int bottom = region.y + region.height < full.height ? region.y + region.height : full.height;
+    if (right <= left || bottom <= top) {
+        return full;
+    }
+
+    region.x = left;
+    region.y = top;
+    region.width = right - left;
+    region.height = bottom - top;
+    return region;
 }
 
 std::string Window::getTitle() const {
-    wchar_t nameBuf[200];
-    if (wnd == GetDesktopWindow()) {
-        return "Desktop";
-    } else if (GetWindowTextW(wnd, nameBuf, sizeof(nameBuf) / sizeof(nameBuf[0])) > 0) {
-        char res[sizeof(nameBuf)];
-        WideCharToMultiByte(CP_UTF8, 0, nameBuf, -1, res, sizeof(res), nullptr, nullptr);
-        return std::string(res);
+    return getMetadata()->title;
+}
+
+std::shared_ptr<const Window::Metadata> Window::getMetadata() const {
+    return std::atomic_load(&metadata);
+}
+
+void Window::refreshMetadata() {
+    auto previous = getMetadata();
+    auto geo = updateGeometry();
+
+    auto meta = std::make_shared<Metadata>();
+    meta->width = geo->rect.right - geo->rect.left;
+    meta->height = geo->rect.bottom - geo->rect.top;
+    meta->title = queryTitle(*geo);
+
+    // the process of a window never changes
+    if (previous) {
+        meta->processName = previous->processName;
     } else {
+        meta->processName = queryProcessName();
+    }
+
+    std::shared_ptr<const Metadata> snapshot = meta;
+    std::atomic_store(&metadata, snapshot);
+}
+
+std::string Window::queryTitle(const Geometry &geo) const {
+    if (monitor) {
+        int width = geo.rect.right - geo.rect.left;
+        int height = geo.rect.bottom - geo.rect.top;
+        return "Monitor " + std::to_string(monitorIndex) + " (" + std::to_string(width) + "x" + std::to_string(height) + ")";
+    } else if (isDesktop()) {
+        return "Desktop";
+    }
+
+    // GetWindowTextW would block forever on a hung window
+    wchar_t nameBuf[200] {};
+    DWORD_PTR len = 0;
+    LRESULT ok = SendMessageTimeoutW(wnd, WM_GETTEXT, sizeof(nameBuf) / sizeof(nameBuf[0]), reinterpret_cast<LPARAM>(nameBuf),
+                                     SMTO_ABORTIFHUNG | SMTO_BLOCK, 100, &len);
+    if (!ok || len == 0) {
+        auto previous = getMetadata();
+        return previous ? previous->title : "";
+    }
+
+    char res[sizeof(nameBuf)];
+    WideCharToMultiByte(CP_UTF8, 0, nameBuf, -1, res, sizeof(res), nullptr, nullptr);
+    return std::string(res);
+}
+
+std::string Window::queryProcessName() const {
+    if (isDesktop()) {
+        return "";
+    }
+
+    DWORD pid = 0;
+    GetWindowThreadProcessId(wnd, &pid);
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, pid);
+    if (!process) {
+        return "";
+    }
+
+    wchar_t pathBuf[MAX_PATH] {};
+    DWORD len = MAX_PATH;
+    bool ok = QueryFullProcessImageNameW(process, 0, pathBuf, &len);
+    CloseHandle(process);
+    if (!ok) {
         return "";
     }
+
+    const wchar_t *name = wcsrchr(pathBuf, L'\\');
+    name = name ? name + 1 : pathBuf;
+
+    char res[sizeof(pathBuf)];
+    WideCharToMultiByte(CP_UTF8, 0, name, -1, res, sizeof(res), nullptr, nullptr);
+    return std::string(res);
+}
+
+bool Window::isResponsive() const {
+    if (isDesktop()) {
+        return true;
+    }
+
+    if (IsHungAppWindow(wnd)) {
+        return false;
+    }
+
+    DWORD_PTR res = 0;
+    return SendMessageTimeoutW(wnd, WM_NULL, 0, 0, SMTO_ABORTIFHUNG | SMTO_BLOCK, 250, &res) != 0;
+}
+
+void Window::screenToRegion(int screenX, int screenY, float &relX, float &relY) const {
+    auto geo = getGeometry();
+    relX = (screenX - geo->rect.left - geo->region.x) / (float) geo->region.width;
+    relY = (screenY - geo->rect.top - geo->region.y) / (float) geo->region.height;
+}
+
+void Window::resizeCaptureRegion(int width, int height) {
+    if (isDesktop() || width <= 0 || height <= 0) {
+        return;
+    }
+
+    auto geo = updateGeometry();
+    const RECT &winRect = geo->rect;
+
+    {
+        // restoreGeometry can be called from the sim thread
+        std::lock_guard<std::mutex> lock(configMutex);
+        if (!cropRegion.isEmpty()) {
+            // the crop region is fixed in window pixels while the content moves when the window
+            // is resized, so resizing can't make it 1:1 - leave the window as the user cropped it
+            return;
+        }
+        if (!isResized) {
+            originalRect = winRect;
+            isResized = true;
+        }
+    }
+
+    // keep the parts outside of the capture region, e.g. borders and title bar
+    const Region &region = geo->region;
+    int newWidth = (winRect.right - winRect.left) + (width - region.width);
+    int newHeight = (winRect.bottom - winRect.top) + (height - region.height);
+
+    if (newWidth == winRect.right - winRect.left && newHeight == winRect.bottom - winRect.top) {
+        return;
+    }
+
+    // async so that a hung application can't block us
+    SetWindowPos(wnd, nullptr, 0, 0, newWidth, newHeight,
+            SWP_NOMOVE | SWP_NOZORDER | SWP_NOOWNERZORDER | SWP_NOACTIVATE | SWP_ASYNCWINDOWPOS);
+}
+
+void Window::restoreGeometry() {
+    RECT rect;
+    {
+        std::lock_guard<std::mutex> lock(configMutex);
+        if (!isResized) {
+            return;
+        }
+        isResized = false;
+        rect = originalRect;
+    }
+
+    SetWindowPos(wnd, nullptr, rect.left, rect.top,
+            rect.right - rect.left, rect.bottom - rect.top,
+            SWP_NOZORDER | SWP_NOOWNERZORDER | SWP_NOACTIVATE | SWP_ASYNCWINDOWPOS);
+}
+
+void Window::setMaxTileSize(int size) {
+    maxTileSize = size;
+}
+
+void Window::setParallelFor(ParallelFor parallel) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    parallelFor = parallel;
+}
+
+Window::ParallelFor Window::getParallelFor() const {
+    std::lock_guard<std::mutex> lock(configMutex);
+    return parallelFor;
+}
+
+void Window::setDesktopCapture(std::shared_ptr<DesktopCapture> capture) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    if (desktopCapture == capture) {
+        return;
+    }
+    if (desktopCapture) {
+        // a capture that is still running with the old token is refused from now on
+        desktopCapture->removeClient(this);
+    }
+    desktopCapture = capture;
+    captureToken = 0;
+}
+
+std::shared_ptr<DesktopCapture> Window::getDesktopCapture(uint64_t &token) {
+    // registering under our lock so that it can't overlap with removing us
+    std::lock_guard<std::mutex> lock(configMutex);
+    if (desktopCapture && captureToken == 0) {
+        captureToken = desktopCapture->addClient(this);
+    }
+    token = captureToken;
+    return desktopCapture;
 }
 
 void Window::onMouseDown(int x, int y) {
-    if (wnd == GetDesktopWindow()) {
+    if (isDesktop()) {
         validClick = false;
         if (GetKeyState(VK_LBUTTON) >= 0) {
-            mouse_event(MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_MOVE | MOUSEEVENTF_LEFTDOWN,
-                    x * 65535 / getWidth(), y * 65535 / getHeight(), 0, 0);
+            sendDesktopMouse(MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_MOVE | MOUSEEVENTF_LEFTDOWN, x, y, 0);
             validClick = true;
         }
     } else  {
@@ -86,10 +376,9 @@ void Window::onMouseDown(int x, int y) {
 }
 
 void Window::onMouseDrag(int x, int y) {
-    if (wnd == GetDesktopWindow()) {
+    if (isDesktop()) {
         if (validClick) {
-            mouse_event(MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_MOVE,
-                    x * 65535 / getWidth(), y * 65535 / getHeight(), 0, 0);
+            sendDesktopMouse(MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_MOVE, x, y, 0);
         }
     } else  {
         HWND dest;
@@ -101,10 +390,9 @@ void Window::onMouseDrag(int x, int y) {
 }
 
 void Window::onMouseUp(int x, int y) {
-    if (wnd == GetDesktopWindow()) {
+    if (isDesktop()) {
         if (validClick) {
-            mouse_event(MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_MOVE | MOUSEEVENTF_LEFTUP,
-                    x * 65535 / getWidth(), y * 65535 / getHeight(), 0, 0);
+            sendDesktopMouse(MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_MOVE | MOUSEEVENTF_LEFTUP, x, y, 0);
         }
     } else  {
         HWND dest;
@@ -116,18 +404,38 @@ void Window::onMouseUp(int x, int y) {
 }
 
 void Window::onWheel(int x, int y, int dir) {
-    if (wnd == GetDesktopWindow()) {
-            mouse_event(MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_WHEEL,
-                    x * 65535 / getWidth(), y * 65535 / getHeight(), dir * 15, 0);
+    if (isDesktop()) {
+        sendDesktopMouse(MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_WHEEL, x, y, dir * 15);
     } else  {
         HWND dest;
         convertMouseCoords(x, y, dest);
         if (dest) {
-            PostMessageA(dest, WM_VSCROLL, MAKEWPARAM(dir < 0 ? SB_LINEDOWN : SB_LINEUP, 0), 0);
+            // several ticks can be merged into one call
+            int lines = dir < 0 ? -dir : dir;
+            for (int i = 0; i < lines; i++) {
+                PostMessageA(dest, WM_VSCROLL, MAKEWPARAM(dir < 0 ? SB_LINEDOWN : SB_LINEUP, 0), 0);
+            }
         }
     }
 }
 
+void Window::sendDesktopMouse(DWORD flags, int x, int y, DWORD data) {
+    // absolute coordinates are normalized to the virtual screen that spans all monitors
+    const RECT &src = getGeometry()->rect;
+    int screenX = GetSystemMetrics(SM_XVIRTUALSCREEN);
+    int screenY = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    int screenWidth = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+    int screenHeight = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+
+    if (screenWidth <= 0 || screenHeight <= 0) {
+        return;
+    }
+
+    DWORD absX = (src.left + x - screenX) * 65535 / screenWidth;
+    DWORD absY = (src.top + y - screenY) * 65535 / screenHeight;
+    mouse_event(flags | MOUSEEVENTF_VIRTUALDESK, absX, absY, data, 0);
+}
+
 void Window::convertMouseCoords(int &x, int &y, HWND &out) {
     int winX = x, winY = y;
 
@@ -154,34 +462,167 @@ void Window::convertMouseCoords(int &x, int &y, HWND &out) {
 }
 
 void Window::updateScreenshot(int width, int height, int quality) {
-    HDC windowDC = GetWindowDC(wnd);
+    int stretchMode;
+    if (quality == 0) {
+        stretchMode = STRETCH_ANDSCANS;
+    } else if (quality == 1) {
+        stretchMode = STRETCH_DELETESCANS;
+    } else {
+        stretchMode = STRETCH_HALFTONE;
+    }
 
-    RECT winRect;
-    GetWindowRect(wnd, &winRect);
-    int winWidth = winRect.right - winRect.left;
-    int winHeight = winRect.bottom - winRect.top;
+    auto geo = updateGeometry();
+    const RECT &winRect = geo->rect;
+
+    uint64_t token = 0;
+    auto sharedCapture = getDesktopCapture(token);
+    if (sharedCapture) {
+        HDC screenDC = GetDC(nullptr);
+        updateBitmapIfDimensionChanged(screenDC, width, height);
+        ReleaseDC(nullptr, screenDC);
+
+        const Region &region = geo->region;
+        RECT screenRect {
+            winRect.left + region.x,
+            winRect.top + region.y,
+            winRect.left + region.x + region.width,
+            winRect.top + region.y + region.height
+        };
+
+        HBITMAP origBitmap = (HBITMAP) SelectObject(compDC, bitmap);
+        bool copied = sharedCapture->copyRegion(this, token, screenRect, compDC, bitmapWidth, bitmapHeight, stretchMode);
+        SelectObject(compDC, origBitmap);
+        if (copied) {
+            convertBitmap();
+            return;
+        }
+        // the shared capture was turned off during the capture, capture on our own this time
+    }
+
+    // only the capture region is read from the window DC, so the cost scales with its area
+    Region src = geo->region;
 
-    if (GetDpiForSystem_ && GetDpiForWindow_) {
-        int wndDpi = GetDpiForWindow_(wnd);
-        int sysDpi = GetDpiForSystem_();
+    if (monitor) {
+        src.x += winRect.left;
+        src.y += winRect.top;
+    } else {
+        src.x = MulDiv(src.x, geo->dpi, geo->systemDpi);
+        src.y = MulDiv(src.y, geo->dpi, geo->systemDpi);
+        src.width = MulDiv(src.width, geo->dpi, geo->systemDpi);
+        src.height = MulDiv(src.height, geo->dpi, geo->systemDpi);
+    }
 
-        winWidth = MulDiv(winWidth, wndDpi, sysDpi);
-        winHeight = MulDiv(winHeight, wndDpi, sysDpi);
+    int tileSize = maxTileSize;
+    if (tileSize > 0 && (width > tileSize || height > tileSize)) {
+        captureTiles(src, width, height, stretchMode);
+        return;
     }
 
+    HDC windowDC = getSourceDC();
     updateBitmapIfDimensionChanged(windowDC, width, height);
 
     HBITMAP origBitmap = (HBITMAP) SelectObject(compDC, bitmap);
-    if (quality == 0) {
-        SetStretchBltMode(compDC, STRETCH_ANDSCANS);
-    } else if (quality == 1) {
-        SetStretchBltMode(compDC, STRETCH_DELETESCANS);
+    if (src.width == bitmapWidth && src.height == bitmapHeight) {
+        // the window matches the VR size, no need to resample
+        BitBlt(compDC, 0, 0, bitmapWidth, bitmapHeight, windowDC, src.x, src.y, SRCCOPY);
     } else {
-        SetStretchBltMode(compDC, STRETCH_HALFTONE);
+        SetStretchBltMode(compDC, stretchMode);
+        StretchBlt(compDC, 0, 0, bitmapWidth, bitmapHeight, windowDC, src.x, src.y, src.width, src.height, SRCCOPY);
     }
-    StretchBlt(compDC, 0, 0, bitmapWidth, bitmapHeight, windowDC, 0, 0, winWidth, winHeight, SRCCOPY);
     SelectObject(compDC, origBitmap);
+    releaseSourceDC(windowDC);
+
+    convertBitmap();
+}
+
+void Window::captureTiles(const Region &src, int width, int height, int stretchMode) {
+    int tileSize = maxTileSize;
+    int cols = (width + tileSize - 1) / tileSize;
+    int rows = (height + tileSize - 1) / tileSize;
+    int tileWidth = (width + cols - 1) / cols;
+    int tileHeight = (height + rows - 1) / rows;
+
+    preparePixels(width, height);
+
+    std::vector<std::pair<Region, Region>> tiles;
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            Region dst;
+            dst.x = col * tileWidth;
+            dst.y = row * tileHeight;
+            dst.width = (dst.x + tileWidth <= width) ? tileWidth : width - dst.x;
+            dst.height = (dst.y + tileHeight <= height) ? tileHeight : height - dst.y;
+
+            Region part;
+            part.x = src.x + MulDiv(dst.x, src.width, width);
+            part.y = src.y + MulDiv(dst.y, src.height, height);
+            part.width = src.x + MulDiv(dst.x + dst.width, src.width, width) - part.x;
+            part.height = src.y + MulDiv(dst.y + dst.height, src.height, height) - part.y;
+
+            tiles.emplace_back(part, dst);
+        }
+    }
+
+    auto job = [this, &tiles, stretchMode] (size_t i) {
+        captureTile(tiles[i].first, tiles[i].second, stretchMode);
+    };
+
+    ParallelFor parallel = getParallelFor();
+    if (parallel) {
+        parallel(tiles.size(), job);
+    } else {
+        for (size_t i = 0; i < tiles.size(); i++) {
+            job(i);
+        }
+    }
+
+    updateStagingBytes();
+}
+
+void Window::captureTile(Region src, Region dst, int stretchMode) {
+    // each tile uses its own DCs so that all tiles can be captured at the same time
+    HDC sourceDC = getSourceDC();
+    HDC tileDC = CreateCompatibleDC(sourceDC);
+
+    BITMAPINFO info {};
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = dst.width;
+    info.bmiHeader.biHeight = -dst.height; // top-down like our screenshot
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 24;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    void *bits = nullptr;
+    HBITMAP tileBitmap = CreateDIBSection(tileDC, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (tileBitmap && bits) {
+        HGDIOBJ origBitmap = SelectObject(tileDC, tileBitmap);
+        if (src.width == dst.width && src.height == dst.height) {
+            BitBlt(tileDC, 0, 0, dst.width, dst.height, sourceDC, src.x, src.y, SRCCOPY);
+        } else {
+            SetStretchBltMode(tileDC, stretchMode);
+            StretchBlt(tileDC, 0, 0, dst.width, dst.height, sourceDC, src.x, src.y, src.width, src.height, SRCCOPY);
+        }
+        GdiFlush();
+
+        // DIB rows are DWORD aligned, the tile is copied into its part of the screenshot
+        int tileStride = (3 * dst.width + (4 - 1)) & ~(4 - 1);
+        const uint8_t *srcRow = (const uint8_t *) bits;
+        uint8_t *dstRow = shot.pixels.data() + dst.y * shot.stride + dst.x * 3;
+        for (int y = 0; y < dst.height; y++) {
+            memcpy(dstRow, srcRow, dst.width * 3);
+            srcRow += tileStride;
+            dstRow += shot.stride;
+        }
+
+        SelectObject(tileDC, origBitmap);
+        DeleteObject(tileBitmap);
+    }
 
+    DeleteDC(tileDC);
+    releaseSourceDC(sourceDC);
+}
+
+void Window::convertBitmap() {
     Gdiplus::Bitmap b(bitmap, nullptr);
     Gdiplus::Rect srcRect(0, 0, b.GetWidth(), b.GetHeight());
 
@@ -191,17 +632,14 @@ void Window::updateScreenshot(int width, int height, int quality) {
     data.PixelFormat = PixelFormat24bppRGB;
     data.Stride = (3 * data.Width + (4 - 1)) & ~(4 - 1);
 
-    shot.width = data.Width;
-    shot.height = data.Height;
-    shot.stride = std::abs((long) data.Stride);
-    shot.pixels.resize(shot.stride * shot.height);
+    preparePixels(data.Width, data.Height);
 
     data.Scan0 = shot.pixels.data();
 
     b.LockBits(&srcRect, Gdiplus::ImageLockModeRead | Gdiplus::ImageLockModeUserInputBuf, data.PixelFormat, &data);
     b.UnlockBits(&data);
 
-    ReleaseDC(wnd, windowDC);
+    updateStagingBytes();
 }
 
 void Window::updateBitmapIfDimensionChanged(HDC winDC, int width, int height) {
@@ -225,73 +663,133 @@ const Window::Screenshot& Window::getLastScreenshot() const {
     return shot;
 }
 
-Window::~Window() {
+Window::Screenshot Window::takeScreenshot() {
+    // the next capture gets a recycled buffer from the frame pool
+    Screenshot res = std::move(shot);
+    updateStagingBytes();
+    return res;
+}
+
+size_t Window::getStagingBytes() const {
+    return stagingBytes;
+}
+
+void Window::releaseStagingMemory() {
+    // a shared snapshot is freed when no window uses it, we're added again with the next capture
+    {
+        std::lock_guard<std::mutex> lock(configMutex);
+        if (desktopCapture) {
+            desktopCapture->removeClient(this);
+            captureToken = 0;
+        }
+    }
+
+    shot.pixels.reset();
+    shot.width = shot.height = shot.stride = 0;
+
     if (bitmap) {
         DeleteObject(bitmap);
+        bitmap = {};
     }
     if (compDC) {
         DeleteDC(compDC);
+        compDC = {};
     }
+    bitmapWidth = bitmapHeight = 0;
+
+    updateStagingBytes();
 }
 
-std::vector<std::shared_ptr<Window>> findWindows() {
-    std::vector<std::shared_ptr<Window>> res;
+void Window::preparePixels(int width, int height) {
+    shot.width = width;
+    shot.height = height;
+    shot.stride = (3 * width + (4 - 1)) & ~(4 - 1);
 
-    res.push_back(std::make_shared<Window>(GetDesktopWindow()));
+    // the pool hands out a recycled buffer when the frame size changes, the pixels are overwritten anyway
+    size_t size = (size_t) shot.stride * shot.height;
+    if (shot.pixels.capacity() != FramePool::sizeClass(size)) {
+        shot.pixels = FramePool::shared().acquire(size);
+    } else {
+        shot.pixels.setSize(size);
+    }
+}
 
-    EnumWindows([] (HWND wnd, LPARAM lparam) -> BOOL {
-        auto *vec = reinterpret_cast<std::vector<std::shared_ptr<Window>> *>(lparam);
+void Window::updateStagingBytes() {
+    // compatible bitmaps use the screen format, assume 32 bits per pixel
+    stagingBytes = shot.pixels.capacity() + (size_t) bitmapWidth * bitmapHeight * 4;
+}
 
-        DWORD pid;
-        GetWindowThreadProcessId(wnd, &pid);
-        if (pid == GetCurrentProcessId()) {
-            return true;
-        }
+Window::~Window() {
+    if (desktopCapture) {
+        desktopCapture->removeClient(this);
+    }
+    if (bitmap) {
+        DeleteObject(bitmap);
+    }
+    if (compDC) {
+        DeleteDC(compDC);
+    }
+}
 
-        if (!IsWindowVisible(wnd)) {
-            return true;
-        }
+std::vector<HMONITOR> findMonitors() {
+    std::vector<HMONITOR> monitors;
+    EnumDisplayMonitors(nullptr, nullptr, [] (HMONITOR mon, HDC, LPRECT, LPARAM lparam) -> BOOL {
+        reinterpret_cast<std::vector<HMONITOR> *>(lparam)->push_back(mon);
+        return true;
+    }, reinterpret_cast<LPARAM>(&monitors));
+    return monitors;
+}
 
-        HWND hwndWalk = nullptr;
-        HWND hwndTry = GetAncestor(wnd, GA_ROOTOWNER);
-        while(hwndTry != hwndWalk)
-        {
-            hwndWalk = hwndTry;
-            hwndTry = GetLastActivePopup(hwndWalk);
-            if(IsWindowVisible(hwndTry)) {
-                break;
-            }
-        }
-        if(hwndWalk != wnd) {
-            return true;
-        }
+bool isCaptureCandidate(HWND wnd) {
+    if (!IsWindow(wnd) || GetAncestor(wnd, GA_ROOT) != wnd) {
+        return false;
+    }
 
-        if(GetWindowLong(wnd, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) {
-            return true;
-        }
+    DWORD pid;
+    GetWindowThreadProcessId(wnd, &pid);
+    if (pid == GetCurrentProcessId()) {
+        return false;
+    }
 
-        if (GetWindowTextLengthW(wnd) == 0) {
-            return true;
-        }
+    if (!IsWindowVisible(wnd)) {
+        return false;
+    }
 
-        TITLEBARINFO ti;
-        ti.cbSize = sizeof(ti);
-        GetTitleBarInfo(wnd, &ti);
-        if (ti.rgstate[0] & STATE_SYSTEM_INVISIBLE) {
-            char title[255];
-            GetWindowTextA(wnd, title, sizeof(title));
-            bool isEFASS = (strstr(title, "EFASS") == title);
-            bool isReflector = (strstr(title, "Reflector") == title);
-            bool isAirDroid = (strstr(title, "AirDroid Cast v") == title);
-            if (!isEFASS && !isReflector && !isAirDroid) {
-                return true;
-            }
+    HWND hwndWalk = nullptr;
+    HWND hwndTry = GetAncestor(wnd, GA_ROOTOWNER);
+    while(hwndTry != hwndWalk)
+    {
+        hwndWalk = hwndTry;
+        hwndTry = GetLastActivePopup(hwndWalk);
+        if(IsWindowVisible(hwndTry)) {
+            break;
         }
+    }
+    if(hwndWalk != wnd) {
+        return false;
+    }
+
+    if(GetWindowLong(wnd, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) {
+        return false;
+    }
 
-        vec->push_back(std::make_shared<Window>(wnd));
+    if (GetWindowTextLengthW(wnd) == 0) {
+        return false;
+    }
 
-        return true;
-    }, reinterpret_cast<LPARAM>(&res));
+    TITLEBARINFO ti;
+    ti.cbSize = sizeof(ti);
+    GetTitleBarInfo(wnd, &ti);
+    if (ti.rgstate[0] & STATE_SYSTEM_INVISIBLE) {
+        char title[255];
+        GetWindowTextA(wnd, title, sizeof(title));
+        bool isEFASS = (strstr(title, "EFASS") == title);
+        bool isReflector = (strstr(title, "Reflector") == title);
+        bool isAirDroid = (strstr(title, "AirDroid Cast v") == title);
+        if (!isEFASS && !isReflector && !isAirDroid) {
+            return false;
+        }
+    }
 
-    return res;
+    return true;
 }
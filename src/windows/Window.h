@@ -22,25 +22,91 @@
 #include <gdiplus.h>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
 #include <cstdint>
+#include "DesktopCapture.h"
+#include "FramePool.h"
 
 class Window {
 public:
+    // runs job(0) to job(parts - 1) and returns when all of them are done
+    using ParallelFor = std::function<void(size_t parts, const std::function<void(size_t)> &job)>;
+
     struct Screenshot {
         int width, height, stride;
-        std::vector<uint8_t> pixels;
+        FramePool::Buffer pixels;
+    };
+
+    // a rectangle in window coordinates, i.e. relative to the top left corner of the window
+    struct Region {
+        int x = 0, y = 0, width = 0, height = 0;
+
+        bool isEmpty() const { return width <= 0 || height <= 0; }
+        bool contains(int px, int py) const { return px >= x && px < x + width && py >= y && py < y + height; }
     };
 
     Window(HWND hWnd);
+    Window(HMONITOR hMonitor, int index);
     bool isEqual(const Window &other) const;
 
     std::string getTitle() const;
     int getWidth() const;
     int getHeight() const;
 
+    // an empty crop region captures the whole window (or its client area if borders are trimmed)
+    void setCropRegion(const Region &region);
+    Region getCropRegion() const;
+    void setTrimBorders(bool trim);
+    bool getTrimBorders() const;
+
+    // the geometry is published with every capture, reading it never calls into the window system
+    struct Geometry {
+        // screen coordinates of the window or monitor
+        RECT rect {};
+        Region region {};
+        int dpi = 96, systemDpi = 96;
+        float aspectRatio = 1;
+    };
+    std::shared_ptr<const Geometry> getGeometry() const;
+    std::shared_ptr<const Geometry> updateGeometry();
+
+    // cached for the UI, refreshed by the discovery thread so that hung windows can't block the caller
+    struct Metadata {
+        std::string title;
+        std::string processName;
+        int width = 0, height = 0;
+    };
+    std::shared_ptr<const Metadata> getMetadata() const;
+    void refreshMetadata();
+
+    // converts screen coordinates into coordinates relative to the capture region, i.e. 0 to 1 if inside
+    void screenToRegion(int screenX, int screenY, float &relX, float &relY) const;
+
+    // resizes the window so that its capture region gets the given size, remembering the original geometry.
+    // Does nothing while a crop region is set.
+    void resizeCaptureRegion(int width, int height);
+    void restoreGeometry();
+
+    // capture from a desktop snapshot shared with other windows instead of grabbing on our own
+    void setDesktopCapture(std::shared_ptr<DesktopCapture> capture);
+
+    // larger screenshots are captured as tiles, in parallel if a ParallelFor is set
+    void setMaxTileSize(int size);
+    void setParallelFor(ParallelFor parallel);
+
+    // checks that the owning application still handles messages, without blocking on hung windows
+    bool isResponsive() const;
     void updateScreenshot(int width, int height, int quality);
     float getAspectRatio() const;
     const Screenshot &getLastScreenshot() const;
+    // moves the last screenshot out so that the next capture can run while it is processed
+    Screenshot takeScreenshot();
+
+    // host memory used for capturing, releasing it is only allowed from the capture thread
+    size_t getStagingBytes() const;
+    void releaseStagingMemory();
 
     void onMouseDown(int x, int y);
     void onMouseDrag(int x, int y);
@@ -50,18 +116,51 @@ public:
     ~Window();
 private:
     HWND wnd {};
+    HMONITOR monitor {};
+    int monitorIndex = 0;
+    std::shared_ptr<const Metadata> metadata;
 
     HDC compDC {};
     HBITMAP bitmap {};
     int bitmapWidth = 0, bitmapHeight = 0;
     bool validClick = false;
 
+    mutable std::mutex configMutex;
+    Region cropRegion {};
+    bool trimBorders = false;
+    std::shared_ptr<DesktopCapture> desktopCapture;
+    // registration with desktopCapture, 0 until the next capture registers us
+    uint64_t captureToken = 0;
+    ParallelFor parallelFor;
+    RECT originalRect {};
+    bool isResized = false;
+
+    std::atomic_int maxTileSize { 0 };
+    std::atomic_size_t stagingBytes { 0 };
+
+    std::shared_ptr<const Geometry> geometry;
     Screenshot shot {};
 
+    bool isDesktop() const;
+    RECT getSourceRect() const;
+    Region calculateCaptureRegion(const RECT &winRect) const;
+    HDC getSourceDC() const;
+    void releaseSourceDC(HDC dc) const;
+    void sendDesktopMouse(DWORD flags, int x, int y, DWORD data);
+    void captureTiles(const Region &src, int width, int height, int stretchMode);
+    void captureTile(Region src, Region dst, int stretchMode);
     void updateBitmapIfDimensionChanged(HDC winDC, int width, int height);
+    std::shared_ptr<DesktopCapture> getDesktopCapture(uint64_t &token);
+    ParallelFor getParallelFor() const;
+    std::string queryTitle(const Geometry &geo) const;
+    std::string queryProcessName() const;
+    void convertBitmap();
+    void updateStagingBytes();
+    void preparePixels(int width, int height);
     void convertMouseCoords(int &x, int &y, HWND &out);
 };
 
-std::vector<std::shared_ptr<Window>> findWindows();
+std::vector<HMONITOR> findMonitors();
+bool isCaptureCandidate(HWND wnd);
 
 #endif /* SRC_WINDOWS_WINDOW_H_ */
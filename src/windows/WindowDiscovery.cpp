@@ -0,0 +1,237 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include "WindowDiscovery.h"
+#include "src/Logger.h"
+
+namespace {
+    // full rescans catch monitor changes and events that didn't mark a window dirty
+    constexpr const std::chrono::seconds RESCAN_INTERVAL(5);
+    constexpr const DWORD WAIT_TIMEOUT_MS = 250;
+
+    // titles are also refreshed on name changes, but at most once per wait cycle
+    constexpr const std::chrono::seconds METADATA_INTERVAL(2);
+
+    // out-of-context hooks are called on the thread that installed them
+    thread_local WindowDiscovery *hookOwner = nullptr;
+}
+
+WindowDiscovery::WindowDiscovery() {
+    std::shared_ptr<const Snapshot> empty = std::make_shared<Snapshot>();
+    std::atomic_store(&snapshot, empty);
+    thread = std::make_unique<std::thread>(&WindowDiscovery::run, this);
+}
+
+std::shared_ptr<const WindowDiscovery::Snapshot> WindowDiscovery::getSnapshot() const {
+    return std::atomic_load(&snapshot);
+}
+
+void WindowDiscovery::run() {
+    // create the message queue before the thread id is published so that WM_QUIT can't get lost
+    MSG msg;
+    PeekMessage(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+    threadId = GetCurrentThreadId();
+    hookOwner = this;
+
+    DWORD hookFlags = WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS;
+    HWINEVENTHOOK showHook = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_HIDE, nullptr, onWinEvent, 0, 0, hookFlags);
+    HWINEVENTHOOK nameHook = SetWinEventHook(EVENT_OBJECT_NAMECHANGE, EVENT_OBJECT_NAMECHANGE, nullptr, onWinEvent, 0, 0, hookFlags);
+    if (!showHook || !nameHook) {
+        logger::warn("Couldn't install window event hooks, relying on periodic rescans");
+    }
+
+    desktop = std::make_shared<Window>(GetDesktopWindow());
+    rescan();
+    publish();
+    auto nextRescan = std::chrono::steady_clock::now() + RESCAN_INTERVAL;
+    auto nextMetadata = std::chrono::steady_clock::now() + METADATA_INTERVAL;
+
+    while (keepRunning) {
+        MsgWaitForMultipleObjects(0, nullptr, FALSE, WAIT_TIMEOUT_MS, QS_ALLINPUT);
+        while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                keepRunning = false;
+            }
+            DispatchMessage(&msg);
+        }
+
+        if (!keepRunning) {
+            break;
+        }
+
+        bool changed;
+        if (std::chrono::steady_clock::now() >= nextRescan) {
+            changed = rescan();
+            nextRescan = std::chrono::steady_clock::now() + RESCAN_INTERVAL;
+        } else {
+            changed = processDirty();
+        }
+
+        if (std::chrono::steady_clock::now() >= nextMetadata) {
+            refreshAllMetadata();
+            nextMetadata = std::chrono::steady_clock::now() + METADATA_INTERVAL;
+        } else {
+            refreshRenamed();
+        }
+
+        if (changed) {
+            publish();
+        }
+    }
+
+    if (nameHook) {
+        UnhookWinEvent(nameHook);
+    }
+    if (showHook) {
+        UnhookWinEvent(showHook);
+    }
+    hookOwner = nullptr;
+}
+
+void CALLBACK WindowDiscovery::onWinEvent(HWINEVENTHOOK hook, DWORD event, HWND wnd, LONG idObject, LONG idChild, DWORD thread, DWORD time) {
+    if (!hookOwner || !wnd || idObject != OBJID_WINDOW || idChild != CHILDID_SELF) {
+        return;
+    }
+
+    // destroyed windows can't be queried anymore, so known ones are always marked
+    bool known = hookOwner->index.find(wnd) != hookOwner->index.end();
+    if (known || GetAncestor(wnd, GA_ROOT) == wnd) {
+        hookOwner->dirty.insert(wnd);
+    }
+
+    if (known && event == EVENT_OBJECT_NAMECHANGE) {
+        hookOwner->renamed.insert(wnd);
+    }
+}
+
+void WindowDiscovery::refreshRenamed() {
+    for (HWND wnd: renamed) {
+        auto it = index.find(wnd);
+        if (it != index.end()) {
+            it->second->refreshMetadata();
+        }
+    }
+    renamed.clear();
+}
+
+void WindowDiscovery::refreshAllMetadata() {
+    desktop->refreshMetadata();
+    for (auto &entry: monitors) {
+        entry.second->refreshMetadata();
+    }
+    for (auto &entry: index) {
+        entry.second->refreshMetadata();
+    }
+    renamed.clear();
+}
+
+bool WindowDiscovery::processDirty() {
+    bool changed = false;
+
+    for (HWND wnd: dirty) {
+        bool candidate = isCaptureCandidate(wnd);
+        auto it = index.find(wnd);
+        if (candidate && it == index.end()) {
+            index.insert(std::make_pair(wnd, std::make_shared<Window>(wnd)));
+            order.push_back(wnd);
+            changed = true;
+        } else if (!candidate && it != index.end()) {
+            index.erase(it);
+            order.erase(std::remove(order.begin(), order.end(), wnd), order.end());
+            changed = true;
+        }
+    }
+    dirty.clear();
+
+    return changed;
+}
+
+bool WindowDiscovery::rescan() {
+    bool changed = false;
+
+    auto currentMonitors = findMonitors();
+    if (currentMonitors != monitorOrder) {
+        monitorOrder = currentMonitors;
+        monitors.clear();
+        for (size_t i = 0; i < monitorOrder.size(); i++) {
+            monitors.insert(std::make_pair(monitorOrder[i], std::make_shared<Window>(monitorOrder[i], i + 1)));
+        }
+        changed = true;
+    }
+
+    std::unordered_set<HWND> found;
+    EnumWindows([] (HWND wnd, LPARAM lparam) -> BOOL {
+        if (isCaptureCandidate(wnd)) {
+            reinterpret_cast<std::unordered_set<HWND> *>(lparam)->insert(wnd);
+        }
+        return true;
+    }, reinterpret_cast<LPARAM>(&found));
+
+    // keep the order of known windows stable so that the list doesn't jump around
+    for (auto it = order.begin(); it != order.end(); ) {
+        if (found.erase(*it) == 0) {
+            index.erase(*it);
+            it = order.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+
+    for (HWND wnd: found) {
+        index.insert(std::make_pair(wnd, std::make_shared<Window>(wnd)));
+        order.push_back(wnd);
+        changed = true;
+    }
+
+    dirty.clear();
+    return changed;
+}
+
+void WindowDiscovery::publish() {
+    auto snap = std::make_shared<Snapshot>();
+    snap->generation = ++generation;
+    snap->windows.reserve(1 + monitors.size() + order.size());
+
+    snap->windows.push_back(desktop);
+
+    // with several monitors, each of them can be moved on its own
+    if (monitorOrder.size() > 1) {
+        for (HMONITOR mon: monitorOrder) {
+            snap->windows.push_back(monitors[mon]);
+        }
+    }
+
+    for (HWND wnd: order) {
+        snap->windows.push_back(index[wnd]);
+    }
+
+    std::shared_ptr<const Snapshot> published = snap;
+    std::atomic_store(&snapshot, published);
+}
+
+WindowDiscovery::~WindowDiscovery() {
+    keepRunning = false;
+    if (threadId) {
+        PostThreadMessage(threadId, WM_QUIT, 0, 0);
+    }
+    if (thread) {
+        thread->join();
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_WINDOWS_WINDOWDISCOVERY_H_
+#define SRC_WINDOWS_WINDOWDISCOVERY_H_
+
+#include <windows.h>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include "Window.h"
+
+/*
+ * Keeps the list of capturable windows up to date on a background thread.
+ * Changes are picked up incrementally from window events, a periodic full rescan
+ * catches monitor changes and anything the events missed. Readers only get
+ * immutable snapshots, so they never call into the window system. The metadata
+ * of the windows is refreshed on the same thread.
+ */
+class WindowDiscovery {
+public:
+    struct Snapshot {
+        uint64_t generation = 0;
+        std::vector<std::shared_ptr<Window>> windows;
+    };
+
+    WindowDiscovery();
+    std::shared_ptr<const Snapshot> getSnapshot() const;
+    ~WindowDiscovery();
+private:
+    std::shared_ptr<const Snapshot> snapshot;
+    std::unique_ptr<std::thread> thread;
+    std::atomic_bool keepRunning { true };
+    std::atomic<DWORD> threadId { 0 };
+
+    // only accessed by the discovery thread
+    std::shared_ptr<Window> desktop;
+    std::unordered_map<HMONITOR, std::shared_ptr<Window>> monitors;
+    std::vector<HMONITOR> monitorOrder;
+    std::unordered_map<HWND, std::shared_ptr<Window>> index;
+    std::vector<HWND> order;
+    std::unordered_set<HWND> dirty;
+    std::unordered_set<HWND> renamed;
+    uint64_t generation = 0;
+
+    void run();
+    bool rescan();
+    bool processDirty();
+    void publish();
+    void refreshRenamed();
+    void refreshAllMetadata();
+
+    static void CALLBACK onWinEvent(HWINEVENTHOOK hook, DWORD event, HWND wnd, LONG idObject, LONG idChild, DWORD thread, DWORD time);
+};
+
+#endif /* SRC_WINDOWS_WINDOWDISCOVERY_H_ */
@@ -0,0 +1,136 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include "PanelRegions.h"
+
+namespace {
+    // panels are a few thousand pixels wide, so regions only cover a handful of cells
+    constexpr const int CELL_SIZE = 256;
+    // limits the number of cells for mistyped regions, larger than any panel
+    constexpr const int MAX_EXTENT = 16384;
+
+    int toCell(float v) {
+        return (int) std::floor(v / CELL_SIZE);
+    }
+}
+
+void PanelRegions::set(XPLMWindowID wnd, const Region &newRegion) {
+    remove(wnd);
+    if (newRegion.isEmpty()) {
+        return;
+    }
+
+    Region region = newRegion;
+    if (region.width > MAX_EXTENT) {
+        region.width = MAX_EXTENT;
+    }
+    if (region.height > MAX_EXTENT) {
+        region.height = MAX_EXTENT;
+    }
+
+    Entry entry;
+    entry.region = region;
+    entry.order = nextOrder++;
+    entries[wnd] = entry;
+    insertCells(wnd, region);
+}
+
+void PanelRegions::remove(XPLMWindowID wnd) {
+    auto it = entries.find(wnd);
+    if (it == entries.end()) {
+        return;
+    }
+
+    removeCells(wnd, it->second.region);
+    entries.erase(it);
+}
+
+void PanelRegions::clear() {
+    entries.clear();
+    cells.clear();
+}
+
+bool PanelRegions::has(XPLMWindowID wnd) const {
+    return entries.find(wnd) != entries.end();
+}
+
+PanelRegions::Region PanelRegions::get(XPLMWindowID wnd) const {
+    auto it = entries.find(wnd);
+    if (it == entries.end()) {
+        return Region {};
+    }
+    return it->second.region;
+}
+
+XPLMWindowID PanelRegions::find(float px, float py) const {
+    auto cell = cells.find(cellKey(toCell(px), toCell(py)));
+    if (cell == cells.end()) {
+        return nullptr;
+    }
+
+    XPLMWindowID res = nullptr;
+    uint64_t resOrder = 0;
+    for (auto wnd: cell->second) {
+        const Entry &entry = entries.at(wnd);
+        if (entry.region.contains(px, py) && (!res || entry.order > resOrder)) {
+            res = wnd;
+            resOrder = entry.order;
+        }
+    }
+    return res;
+}
+
+void PanelRegions::toRegion(XPLMWindowID wnd, float px, float py, float &relX, float &relY) const {
+    Region region = get(wnd);
+    if (region.isEmpty()) {
+        relX = relY = -1;
+        return;
+    }
+
+    relX = (px - region.x) / region.width;
+    relY = (py - region.y) / region.height;
+}
+
+int64_t PanelRegions::cellKey(int cx, int cy) {
+    return (int64_t) (((uint64_t) (uint32_t) cx << 32) | (uint32_t) cy);
+}
+
+void PanelRegions::insertCells(XPLMWindowID wnd, const Region &region) {
+    for (int cy = toCell(region.y); cy <= toCell(region.y + region.height - 1); cy++) {
+        for (int cx = toCell(region.x); cx <= toCell(region.x + region.width - 1); cx++) {
+            cells[cellKey(cx, cy)].push_back(wnd);
+        }
+    }
+}
+
+void PanelRegions::removeCells(XPLMWindowID wnd, const Region &region) {
+    for (int cy = toCell(region.y); cy <= toCell(region.y + region.height - 1); cy++) {
+        for (int cx = toCell(region.x); cx <= toCell(region.x + region.width - 1); cx++) {
+            auto it = cells.find(cellKey(cx, cy));
+            if (it == cells.end()) {
+                continue;
+            }
+            auto &list = it->second;
+            list.erase(std::remove(list.begin(), list.end(), wnd), list.end());
+            if (list.empty()) {
+                cells.erase(it);
+            }
+        }
+    }
+}
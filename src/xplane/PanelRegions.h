@@ -0,0 +1,67 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2018 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SRC_XPLANE_PANELREGIONS_H_
+#define SRC_XPLANE_PANELREGIONS_H_
+
+#include <XPLM/XPLMDisplay.h>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+/*
+ * Maps parts of the cockpit panel to the windows that should receive VR trigger clicks on them.
+ * Regions are kept in a uniform grid so that finding the window for a click only checks the
+ * few regions that overlap the clicked cell. Newer regions win where regions overlap.
+ */
+class PanelRegions {
+public:
+    // in panel pixels, the origin is at the bottom left like in X-Plane
+    struct Region {
+        int x = 0, y = 0, width = 0, height = 0;
+
+        bool isEmpty() const { return width <= 0 || height <= 0; }
+        bool contains(float px, float py) const { return px >= x && px < x + width && py >= y && py < y + height; }
+    };
+
+    void set(XPLMWindowID wnd, const Region &region);
+    void remove(XPLMWindowID wnd);
+    void clear();
+    bool has(XPLMWindowID wnd) const;
+    Region get(XPLMWindowID wnd) const;
+
+    // returns the window whose region contains the point, nullptr if none
+    XPLMWindowID find(float px, float py) const;
+    // converts panel pixels into coordinates relative to the window's region, i.e. 0 to 1 if inside
+    void toRegion(XPLMWindowID wnd, float px, float py, float &relX, float &relY) const;
+
+private:
+    struct Entry {
+        Region region;
+        uint64_t order = 0;
+    };
+
+    std::unordered_map<XPLMWindowID, Entry> entries;
+    std::unordered_map<int64_t, std::vector<XPLMWindowID>> cells;
+    uint64_t nextOrder = 0;
+
+    static int64_t cellKey(int cx, int cy);
+    void insertCells(XPLMWindowID wnd, const Region &region);
+    void removeCells(XPLMWindowID wnd, const Region &region);
+};
+
+#endif /* SRC_XPLANE_PANELREGIONS_H_ */
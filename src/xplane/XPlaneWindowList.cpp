@@ -16,6 +16,8 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
 #include "XPlaneWindowList.h"
 #include "src/Logger.h"
 
@@ -46,6 +48,33 @@ namespace {
         }
     }
 
+    void onDrawIntercepted(XPLMWindowID wnd, void *ref) {
+        if (instance) {
+            instance->onInterceptedDraw(wnd, ref);
+        }
+    }
+
+    int onClickIntercepted(XPLMWindowID wnd, int x, int y, XPLMMouseStatus status, void *ref) {
+        if (instance) {
+            return instance->onInterceptedClick(wnd, x, y, status, ref);
+        }
+        return 0;
+    }
+
+    XPLMCursorStatus onCursorIntercepted(XPLMWindowID wnd, int x, int y, void *ref) {
+        if (instance) {
+            return instance->onInterceptedCursor(wnd, x, y, ref);
+        }
+        return xplm_CursorDefault;
+    }
+
+    // catches windows that were removed from the middle of the list
+    constexpr const std::chrono::seconds REBUILD_INTERVAL(1);
+
+    float millisSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
     int onLeftClick(XPLMWindowID, int, int, XPLMMouseStatus, void *) { return 0; }
     void onKey(XPLMWindowID, char, XPLMKeyFlags, char, void *, int) { }
     XPLMCursorStatus onCursor(XPLMWindowID, int, int, void *) { return xplm_CursorDefault; }
@@ -173,6 +202,94 @@ std::vector<XPLMWindowID> XPlaneWindowList::findWindows() {
     return res;
 }
 
+const std::vector<XPLMWindowID> &XPlaneWindowList::getWindows() {
+    refreshCache();
+
+    // removing a window from the middle of the list doesn't change the signature
+    bool removed = std::any_of(cachedWindows.begin(), cachedWindows.end(), [this] (XPLMWindowID wnd) {
+        return !isLinked(wnd);
+    });
+    if (removed) {
+        nextRebuild = {};
+        refreshCache();
+    }
+    return cachedWindows;
+}
+
+bool XPlaneWindowList::hasWindow(XPLMWindowID wnd) {
+    refreshCache();
+    return windowSet.find(wnd) != windowSet.end() && isLinked(wnd);
+}
+
+uint64_t XPlaneWindowList::getGeneration() {
+    refreshCache();
+    return generation;
+}
+
+bool XPlaneWindowList::isLinked(XPLMWindowID wnd) {
+    // removed windows keep their pointers, but their former neighbors don't point back anymore
+    auto prev = getPreviousWindow(wnd);
+    if (prev) {
+        return getNextWindow(prev) == wnd;
+    }
+    auto next = getNextWindow(wnd);
+    if (next) {
+        return getPreviousWindow(next) == wnd;
+    }
+    // the list always contains our node, so any other window has a neighbor
+    return wnd == node;
+}
+
+bool XPlaneWindowList::isCacheValid() {
+    if (cachedWindows.empty() || std::chrono::steady_clock::now() >= nextRebuild) {
+        return false;
+    }
+
+    Signature current;
+    current.head = signature.head;
+    current.tail = signature.tail;
+    current.before = getPreviousWindow(node);
+    current.after = getNextWindow(node);
+
+    // the ends must still be linked and still be the ends
+    if (getPreviousWindow(current.head) || !isLinked(current.head)) {
+        return false;
+    }
+    if (getNextWindow(current.tail) || !isLinked(current.tail)) {
+        return false;
+    }
+
+    return current == signature;
+}
+
+void XPlaneWindowList::refreshCache() {
+    if (isCacheValid()) {
+        return;
+    }
+
+    auto windows = findWindows();
+    if (windows != cachedWindows) {
+        cachedWindows = std::move(windows);
+        windowSet.clear();
+        windowSet.insert(cachedWindows.begin(), cachedWindows.end());
+        generation++;
+    }
+
+    // remember the ends so that the next checks don't have to walk the list
+    signature.before = getPreviousWindow(node);
+    signature.after = getNextWindow(node);
+    signature.head = node;
+    for (auto cur = signature.before; cur; cur = getPreviousWindow(cur)) {
+        signature.head = cur;
+    }
+    signature.tail = node;
+    for (auto cur = signature.after; cur; cur = getNextWindow(cur)) {
+        signature.tail = cur;
+    }
+
+    nextRebuild = std::chrono::steady_clock::now() + REBUILD_INTERVAL;
+}
+
 void XPlaneWindowList::sendLeftClick(XPLMWindowID wnd, XPLMMouseStatus status, int x, int y) {
     if (!XPLMGetWindowIsVisible(wnd)) {
         return;
@@ -243,6 +360,178 @@ void XPlaneWindowList::onInjectedCall(XPLMWindowID wnd) {
     *((XPLMDrawWindow_f *) draw) = it->second.second;
 }
 
+void XPlaneWindowList::hookDraw(XPLMWindowID wnd, DrawHook hook) {
+    auto &entry = interceptions[wnd];
+    try {
+        interceptDraw(wnd, entry);
+    } catch (...) {
+        if (!entry.timed) {
+            interceptions.erase(wnd);
+        }
+        throw;
+    }
+    entry.drawHook = hook;
+}
+
+void XPlaneWindowList::unhookDraw(XPLMWindowID wnd) {
+    auto it = interceptions.find(wnd);
+    if (it == interceptions.end()) {
+        return;
+    }
+
+    it->second.drawHook = nullptr;
+    if (!it->second.timed) {
+        restoreCallbacks(wnd, it->second, true, true);
+        interceptions.erase(it);
+    }
+}
+
+void XPlaneWindowList::setCallTimer(CallTimer timer) {
+    callTimer = timer;
+}
+
+void XPlaneWindowList::setTimed(XPLMWindowID wnd, bool timed) {
+    if (!timed) {
+        auto it = interceptions.find(wnd);
+        if (it == interceptions.end() || !it->second.timed) {
+            return;
+        }
+        it->second.timed = false;
+        // the draw callback stays replaced while it is hooked
+        restoreCallbacks(wnd, it->second, !it->second.drawHook, true);
+        if (!it->second.drawHook) {
+            interceptions.erase(it);
+        }
+        return;
+    }
+
+    auto &entry = interceptions[wnd];
+    if (entry.timed) {
+        return;
+    }
+
+    try {
+        interceptDraw(wnd, entry);
+    } catch (...) {
+        if (!entry.drawHook) {
+            interceptions.erase(wnd);
+        }
+        throw;
+    }
+
+    auto click = getCallbackPointer<XPLMHandleMouseClick_f>(wnd, offsetClick);
+    auto cursor = getCallbackPointer<XPLMHandleCursor_f>(wnd, offsetCursor);
+    entry.click = *click;
+    entry.cursor = *cursor;
+    *click = onClickIntercepted;
+    *cursor = onCursorIntercepted;
+    entry.inputReplaced = true;
+    entry.timed = true;
+}
+
+bool XPlaneWindowList::isTimed(XPLMWindowID wnd) {
+    auto it = interceptions.find(wnd);
+    return it != interceptions.end() && it->second.timed;
+}
+
+void XPlaneWindowList::interceptDraw(XPLMWindowID wnd, Interception &entry) {
+    instance = this;
+
+    if (entry.drawReplaced) {
+        return;
+    }
+
+    auto draw = getCallbackPointer<XPLMDrawWindow_f>(wnd, offsetDraw);
+    if (*draw == onDraw) {
+        throw std::runtime_error("Window has a pending injection");
+    }
+
+    entry.draw = *draw;
+    *draw = onDrawIntercepted;
+    entry.drawReplaced = true;
+}
+
+void XPlaneWindowList::restoreCallbacks(XPLMWindowID wnd, Interception &entry, bool draw, bool input) {
+    // destroyed windows are gone from the list, don't touch them anymore
+    bool listed = hasWindow(wnd);
+
+    if (draw && entry.drawReplaced) {
+        auto ptr = getCallbackPointer<XPLMDrawWindow_f>(wnd, offsetDraw);
+        if (listed && *ptr == onDrawIntercepted) {
+            *ptr = entry.draw;
+        }
+        entry.drawReplaced = false;
+    }
+
+    if (input && entry.inputReplaced) {
+        auto click = getCallbackPointer<XPLMHandleMouseClick_f>(wnd, offsetClick);
+        auto cursor = getCallbackPointer<XPLMHandleCursor_f>(wnd, offsetCursor);
+        if (listed && *click == onClickIntercepted) {
+            *click = entry.click;
+        }
+        if (listed && *cursor == onCursorIntercepted) {
+            *cursor = entry.cursor;
+        }
+        entry.inputReplaced = false;
+    }
+}
+
+void XPlaneWindowList::onInterceptedDraw(XPLMWindowID wnd, void *refcon) {
+    auto it = interceptions.find(wnd);
+    if (it == interceptions.end()) {
+        return;
+    }
+
+    // copy so that the hook can unhook itself
+    auto entry = it->second;
+    auto start = std::chrono::steady_clock::now();
+    if (entry.drawHook) {
+        entry.drawHook(wnd, entry.draw, refcon);
+    } else if (entry.draw) {
+        entry.draw(wnd, refcon);
+    }
+
+    if (entry.timed && callTimer) {
+        callTimer(wnd, Callback::DRAW, millisSince(start));
+    }
+}
+
+int XPlaneWindowList::onInterceptedClick(XPLMWindowID wnd, int x, int y, XPLMMouseStatus status, void *refcon) {
+    auto it = interceptions.find(wnd);
+    if (it == interceptions.end() || !it->second.click) {
+        return 0;
+    }
+
+    auto entry = it->second;
+    auto start = std::chrono::steady_clock::now();
+    int res = entry.click(wnd, x, y, status, refcon);
+    if (entry.timed && callTimer) {
+        callTimer(wnd, Callback::CLICK, millisSince(start));
+    }
+    return res;
+}
+
+XPLMCursorStatus XPlaneWindowList::onInterceptedCursor(XPLMWindowID wnd, int x, int y, void *refcon) {
+    auto it = interceptions.find(wnd);
+    if (it == interceptions.end() || !it->second.cursor) {
+        return xplm_CursorDefault;
+    }
+
+    auto entry = it->second;
+    auto start = std::chrono::steady_clock::now();
+    XPLMCursorStatus res = entry.cursor(wnd, x, y, refcon);
+    if (entry.timed && callTimer) {
+        callTimer(wnd, Callback::CURSOR, millisSince(start));
+    }
+    return res;
+}
+
+template<typename T>
+T *XPlaneWindowList::getCallbackPointer(XPLMWindowID wnd, size_t offset) {
+    uint8_t *ptr = (uint8_t *) wnd;
+    return (T *) (ptr + offset);
+}
+
 size_t XPlaneWindowList::findPointerOffset(void *base, size_t size, void *ptr) {
     uintptr_t pattern = (uintptr_t) ptr;
 
@@ -266,6 +555,11 @@ size_t XPlaneWindowList::findIntOffset(void *base, size_t size, int needle) {
 }
 
 XPlaneWindowList::~XPlaneWindowList() {
+    // our callbacks are gone once the plugin is unloaded
+    for (auto &entry: interceptions) {
+        restoreCallbacks(entry.first, entry.second, true, true);
+    }
+
     XPLMDestroyWindow(node);
     if (otherNode) {
         XPLMDestroyWindow(otherNode);
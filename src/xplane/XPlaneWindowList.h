@@ -24,18 +24,46 @@
 #include <cstdint>
 #include <vector>
 #include <map>
+#include <unordered_set>
+#include <chrono>
 
 class XPlaneWindowList {
 public:
     using InjectedFunction = std::function<void(void)>;
+    // receives the window's original draw callback and refcon
+    using DrawHook = std::function<void(XPLMWindowID, XPLMDrawWindow_f, void *)>;
+    enum class Callback { DRAW, CLICK, CURSOR };
+    // receives the duration of each timed callback in milliseconds
+    using CallTimer = std::function<void(XPLMWindowID, Callback, float)>;
 
     XPlaneWindowList();
+    // walks the whole list, prefer the cached variants below
     std::vector<XPLMWindowID> findWindows();
+
+    // cached list, only rebuilt when the list changed, never contains removed windows
+    const std::vector<XPLMWindowID> &getWindows();
+    // constant time, e.g. for callbacks that run every frame
+    bool hasWindow(XPLMWindowID wnd);
+    // incremented whenever the cached list changes
+    uint64_t getGeneration();
     XPLMPluginID getPluginFromWindow(XPLMWindowID wnd);
     void sendCursorMove(XPLMWindowID wnd, int x, int y);
     void sendLeftClick(XPLMWindowID wnd, XPLMMouseStatus status, int x, int y);
     void injectFunction(XPLMWindowID wnd, InjectedFunction function);
     void onInjectedCall(XPLMWindowID wnd);
+
+    // replaces the draw callback of a window until it is unhooked or this list is destroyed
+    void hookDraw(XPLMWindowID wnd, DrawHook hook);
+    void unhookDraw(XPLMWindowID wnd);
+
+    // times the draw, click and cursor callbacks of a window, including its draw hook
+    void setCallTimer(CallTimer timer);
+    void setTimed(XPLMWindowID wnd, bool timed);
+    bool isTimed(XPLMWindowID wnd);
+
+    void onInterceptedDraw(XPLMWindowID wnd, void *refcon);
+    int onInterceptedClick(XPLMWindowID wnd, int x, int y, XPLMMouseStatus status, void *refcon);
+    XPLMCursorStatus onInterceptedCursor(XPLMWindowID wnd, int x, int y, void *refcon);
     ~XPlaneWindowList();
 private:
     static constexpr const size_t OPAQUE_SIZE = 128;
@@ -49,6 +77,32 @@ private:
     size_t offsetPluginId = 0;
     std::map<XPLMWindowID, std::pair<InjectedFunction, XPLMDrawWindow_f>> injectedFunctions;
 
+    // original callbacks of windows that have one of ours installed
+    struct Interception {
+        XPLMDrawWindow_f draw = nullptr;
+        XPLMHandleMouseClick_f click = nullptr;
+        XPLMHandleCursor_f cursor = nullptr;
+        bool drawReplaced = false, inputReplaced = false;
+        DrawHook drawHook;
+        bool timed = false;
+    };
+    std::map<XPLMWindowID, Interception> interceptions;
+    CallTimer callTimer;
+
+    // windows are appended to the end of the list when created or brought to front,
+    // so checking the ends and our neighbors detects most changes in constant time
+    struct Signature {
+        XPLMWindowID head {}, tail {}, before {}, after {};
+        bool operator==(const Signature &other) const {
+            return head == other.head && tail == other.tail && before == other.before && after == other.after;
+        }
+    };
+    std::vector<XPLMWindowID> cachedWindows;
+    std::unordered_set<XPLMWindowID> windowSet;
+    Signature signature {};
+    uint64_t generation = 0;
+    std::chrono::steady_clock::time_point nextRebuild {};
+
     void createNodes();
     void findOffsets();
 
@@ -57,6 +111,13 @@ private:
 
     XPLMWindowID getNextWindow(XPLMWindowID wnd);
     XPLMWindowID getPreviousWindow(XPLMWindowID wnd);
+    template<typename T>
+    T *getCallbackPointer(XPLMWindowID wnd, size_t offset);
+    bool isLinked(XPLMWindowID wnd);
+    bool isCacheValid();
+    void refreshCache();
+    void interceptDraw(XPLMWindowID wnd, Interception &entry);
+    void restoreCallbacks(XPLMWindowID wnd, Interception &entry, bool draw, bool input);
 };
 
 #endif /* MOVEVR_SRC_XPLANE_XPLANEWINDOWLIST_H_ */